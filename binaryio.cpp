@@ -0,0 +1,49 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "binaryio.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+AtomicOutputFile::AtomicOutputFile(const std::string& filename)
+  : _filename(filename), _tmpFilename(), _out()
+{
+  static std::atomic< unsigned long > files(0);
+  std::ostringstream tmp;
+  tmp << filename << ".tmp." << getpid() << '.' << files++;
+  _tmpFilename = tmp.str();
+  _out.open(_tmpFilename.c_str(), std::ios::binary);
+  if (!_out.is_open()) {
+    THROW("Could not write " + filename);
+  }
+}
+
+AtomicOutputFile::~AtomicOutputFile()
+{
+  if (!_tmpFilename.empty()) {
+    _out.close();
+    unlink(_tmpFilename.c_str());
+  }
+}
+
+void AtomicOutputFile::commit()
+{
+  _out.close();
+  if (!_out || rename(_tmpFilename.c_str(), _filename.c_str()) != 0) {
+    THROW("Could not write " + _filename);
+  }
+  _tmpFilename.clear();
+}
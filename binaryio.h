@@ -0,0 +1,100 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_BINARYIO_H
+#define HEADER_BINARYIO_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// Helpers shared by the binary file formats (.pwb, .evb, .ptb, .emb).  Every
+/// section starts on an 8 byte boundary, so that integer and floating
+/// point arrays can be used in place from a page aligned mapping.
+inline size_t alignSection(size_t n)
+{
+  return (n + 7) & ~(size_t)7;
+}
+
+/// True if the \a n + 1 \a offsets of a name or value table start at 0,
+/// never decrease and end at \a end
+inline bool validOffsets(const unsigned long long* offsets, size_t n,
+			 unsigned long long end)
+{
+  if (offsets[0] != 0 || offsets[n] != end) {
+    return false;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (offsets[i + 1] < offsets[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Walks the sections of a mapped file
+class SectionReader
+{
+private:
+  const char* _p;
+
+public:
+  SectionReader(const char* p) : _p(p) {}
+
+  template< class T > const T* take(size_t n) {
+    const T* r = reinterpret_cast< const T* >(_p);
+    _p += alignSection(n * sizeof(T));
+    return r;
+  }
+};
+
+/// Writes arrays as sections, zero padded to the next boundary
+class SectionWriter
+{
+private:
+  std::ostream& _out;
+
+public:
+  SectionWriter(std::ostream& out) : _out(out) {}
+
+  template< class T > void put(const T* p, size_t n) {
+    static const char zeros[8] = { 0 };
+    _out.write(reinterpret_cast< const char* >(p), n * sizeof(T));
+    _out.write(zeros, alignSection(n * sizeof(T)) - n * sizeof(T));
+  }
+  template< class T > void put(const std::vector< T >& v) {
+    put(v.data(), v.size());
+  }
+};
+
+/// An output file written under a unique temporary name and renamed
+/// into place by commit(), so readers never map a partial file and
+/// concurrent writers of one file can not interleave
+class AtomicOutputFile
+{
+private:
+  std::string _filename;
+  std::string _tmpFilename;
+  std::ofstream _out;
+
+public:
+  /// Throws if the temporary file can not be created
+  AtomicOutputFile(const std::string& filename);
+  ~AtomicOutputFile();
+
+  AtomicOutputFile(const AtomicOutputFile &x) = delete;
+  AtomicOutputFile& operator=(const AtomicOutputFile &x) = delete;
+
+  std::ostream& stream() { return _out; }
+
+  /// Closes the file and renames it into place, throwing on failure
+  void commit();
+};
+
+#endif
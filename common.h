@@ -9,7 +9,17 @@
 #ifndef HEADER_DIGMA_COMMON_H
 #define HEADER_DIGMA_COMMON_H
 
+#include <atomic>
+#include <string>
+
 // globals - these are defined in externVars.cpp
-extern bool VERBOSE;
+extern std::atomic< bool > VERBOSE; // read from worker threads
+
+/// True if \a s ends with \a suffix
+inline bool endsWith(const std::string& s, const std::string& suffix)
+{
+  return s.size() >= suffix.size()
+    && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
 
 #endif
@@ -0,0 +1,464 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+#ifdef PARADIGM_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "common.h"
+#include "compressedio.h"
+#include "mappedfile.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+namespace {
+
+const size_t BLOCK_SIZE = 1 << 20;
+const size_t QUEUED_BLOCKS = 4;
+
+void checkZstd()
+{
+#ifndef PARADIGM_WITH_ZSTD
+  THROW("zstd files need a build with WITH_ZSTD=1");
+#endif
+}
+
+/// A source of decompressed bytes
+class Decompressor
+{
+public:
+  virtual ~Decompressor() {}
+  /// Fills up to \a n bytes of \a out; returns 0 at the end of the data
+  virtual size_t read(char* out, size_t n) = 0;
+};
+
+class GzipDecompressor : public Decompressor
+{
+private:
+  gzFile _file;
+
+public:
+  GzipDecompressor(gzFile file) : _file(file) {
+    gzbuffer(_file, 1 << 17);
+  }
+  ~GzipDecompressor() { gzclose(_file); }
+
+  size_t read(char* out, size_t n) {
+    int got = gzread(_file, out, n);
+    int code = Z_OK;
+    const char* message = gzerror(_file, &code);
+    // a file cut short reads as a short count with Z_BUF_ERROR set
+    if (got < 0 || (code != Z_OK && code != Z_STREAM_END)) {
+      THROW(std::string("Could not decompress ") + message);
+    }
+    return got;
+  }
+};
+
+#ifdef PARADIGM_WITH_ZSTD
+class ZstdDecompressor : public Decompressor
+{
+private:
+  FILE* _file;
+  std::string _filename;
+  ZSTD_DStream* _stream;
+  std::vector< char > _in;
+  ZSTD_inBuffer _input;
+  bool _flushing; // the last call filled the output, more may be pending
+  bool _inFrame;  // a frame was started and not yet finished
+
+public:
+  ZstdDecompressor(FILE* file, const std::string& filename)
+    : _file(file), _filename(filename), _stream(ZSTD_createDStream()),
+      _in(ZSTD_DStreamInSize()), _flushing(false), _inFrame(false) {
+    ZSTD_initDStream(_stream);
+    _input.src = _in.data();
+    _input.size = 0;
+    _input.pos = 0;
+  }
+  ~ZstdDecompressor() {
+    ZSTD_freeDStream(_stream);
+    fclose(_file);
+  }
+
+  size_t read(char* out, size_t n) {
+    ZSTD_outBuffer output = { out, n, 0 };
+    while (output.pos == 0) {
+      if (_input.pos == _input.size && !_flushing) {
+	_input.size = fread(_in.data(), 1, _in.size(), _file);
+	_input.pos = 0;
+	if (_input.size == 0) {
+	  if (ferror(_file)) {
+	    THROW("Could not read " + _filename);
+	  }
+	  if (_inFrame) {
+	    THROW("Could not decompress " + _filename + ": truncated file");
+	  }
+	  return 0;
+	}
+      }
+      size_t ret = ZSTD_decompressStream(_stream, &output, &_input);
+      if (ZSTD_isError(ret)) {
+	THROW("Could not decompress " + _filename + ": "
+	      + ZSTD_getErrorName(ret));
+      }
+      _flushing = output.pos == output.size;
+      _inFrame = ret != 0;
+    }
+    return output.pos;
+  }
+};
+#endif
+
+/// Hands out the blocks of a Decompressor that runs on its own thread,
+/// at most QUEUED_BLOCKS ahead of the reader
+class DecompressingStreambuf : public std::streambuf
+{
+private:
+  std::unique_ptr< Decompressor > _source;
+  std::mutex _lock;
+  std::condition_variable _changed;
+  std::deque< std::vector< char > > _blocks;
+  std::vector< char > _current;
+  bool _done;
+  bool _stop;
+  std::exception_ptr _error;
+  std::thread _thread;
+
+  void produce() {
+    try {
+      for (;;) {
+	std::vector< char > block(BLOCK_SIZE);
+	size_t n = 0;
+	size_t got;
+	while (n < block.size()
+	       && (got = _source->read(block.data() + n, block.size() - n)) > 0) {
+	  n += got;
+	}
+	block.resize(n);
+	std::unique_lock< std::mutex > l(_lock);
+	_changed.wait(l, [this] {
+	    return _stop || _blocks.size() < QUEUED_BLOCKS;
+	  });
+	if (_stop) {
+	  return;
+	}
+	if (n == 0) {
+	  _done = true;
+	  _changed.notify_all();
+	  return;
+	}
+	_blocks.push_back(std::move(block));
+	_changed.notify_all();
+      }
+    } catch (...) {
+      std::lock_guard< std::mutex > l(_lock);
+      _error = std::current_exception();
+      _done = true;
+      _changed.notify_all();
+    }
+  }
+
+protected:
+  int_type underflow() {
+    std::unique_lock< std::mutex > l(_lock);
+    _changed.wait(l, [this] { return !_blocks.empty() || _done; });
+    if (_blocks.empty()) {
+      if (_error) {
+	std::rethrow_exception(_error);
+      }
+      return traits_type::eof();
+    }
+    _current.swap(_blocks.front());
+    _blocks.pop_front();
+    _changed.notify_all();
+    setg(_current.data(), _current.data(), _current.data() + _current.size());
+    return traits_type::to_int_type(*gptr());
+  }
+
+public:
+  DecompressingStreambuf(std::unique_ptr< Decompressor > source)
+    : _source(std::move(source)), _done(false), _stop(false) {
+    _thread = std::thread(&DecompressingStreambuf::produce, this);
+  }
+  ~DecompressingStreambuf() {
+    {
+      std::lock_guard< std::mutex > l(_lock);
+      _stop = true;
+      _changed.notify_all();
+    }
+    _thread.join();
+  }
+};
+
+class DecompressingIStream : public std::istream
+{
+private:
+  DecompressingStreambuf _buf;
+
+public:
+  DecompressingIStream(std::unique_ptr< Decompressor > source)
+    : std::istream(NULL), _buf(std::move(source)) {
+    rdbuf(&_buf);
+    exceptions(std::ios::badbit); // so decompression errors reach the reader
+  }
+};
+
+/// A sink for the bytes of a compressed file
+class Compressor
+{
+public:
+  virtual ~Compressor() {}
+  virtual bool write(const char* data, size_t n) = 0;
+  /// Makes everything written so far decompressible
+  virtual bool flush() = 0;
+  /// Ends the compressed data and closes the file
+  virtual bool finish() = 0;
+};
+
+class GzipCompressor : public Compressor
+{
+private:
+  gzFile _file;
+
+public:
+  GzipCompressor(gzFile file) : _file(file) {
+    gzbuffer(_file, 1 << 17);
+  }
+  ~GzipCompressor() {
+    if (_file != NULL) {
+      gzclose(_file);
+    }
+  }
+
+  bool write(const char* data, size_t n) {
+    return n == 0 || gzwrite(_file, data, n) == (int)n;
+  }
+  bool flush() {
+    return gzflush(_file, Z_SYNC_FLUSH) == Z_OK;
+  }
+  bool finish() {
+    int ret = gzclose(_file);
+    _file = NULL;
+    return ret == Z_OK;
+  }
+};
+
+#ifdef PARADIGM_WITH_ZSTD
+class ZstdCompressor : public Compressor
+{
+private:
+  FILE* _file;
+  ZSTD_CCtx* _context;
+  std::vector< char > _out;
+
+  bool compress(const char* data, size_t n, ZSTD_EndDirective mode) {
+    ZSTD_inBuffer input = { data, n, 0 };
+    size_t remaining;
+    do {
+      ZSTD_outBuffer output = { _out.data(), _out.size(), 0 };
+      remaining = ZSTD_compressStream2(_context, &output, &input, mode);
+      if (ZSTD_isError(remaining)
+	  || fwrite(_out.data(), 1, output.pos, _file) != output.pos) {
+	return false;
+      }
+    } while (mode == ZSTD_e_continue ? input.pos < input.size : remaining != 0);
+    return true;
+  }
+
+public:
+  ZstdCompressor(FILE* file)
+    : _file(file), _context(ZSTD_createCCtx()), _out(ZSTD_CStreamOutSize()) {}
+  ~ZstdCompressor() {
+    ZSTD_freeCCtx(_context);
+    if (_file != NULL) {
+      fclose(_file);
+    }
+  }
+
+  bool write(const char* data, size_t n) {
+    return compress(data, n, ZSTD_e_continue);
+  }
+  bool flush() {
+    return compress(NULL, 0, ZSTD_e_flush) && fflush(_file) == 0;
+  }
+  bool finish() {
+    bool ok = compress(NULL, 0, ZSTD_e_end);
+    ok = fclose(_file) == 0 && ok;
+    _file = NULL;
+    return ok;
+  }
+};
+#endif
+
+/// Buffers writes and passes them to a Compressor
+class CompressingStreambuf : public std::streambuf
+{
+private:
+  std::unique_ptr< Compressor > _sink;
+  std::vector< char > _buffer;
+
+  bool drain() {
+    bool ok = _sink->write(pbase(), pptr() - pbase());
+    setp(_buffer.data(), _buffer.data() + _buffer.size());
+    return ok;
+  }
+
+protected:
+  int_type overflow(int_type c) {
+    if (!drain()) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+  int sync() {
+    return drain() && _sink->flush() ? 0 : -1;
+  }
+
+public:
+  CompressingStreambuf(std::unique_ptr< Compressor > sink)
+    : _sink(std::move(sink)), _buffer(1 << 16) {
+    setp(_buffer.data(), _buffer.data() + _buffer.size());
+  }
+  bool close() {
+    bool ok = drain();
+    return _sink->finish() && ok;
+  }
+};
+
+class CompressingOStream : public std::ostream
+{
+private:
+  std::string _filename;
+  CompressingStreambuf _buf;
+
+public:
+  CompressingOStream(std::unique_ptr< Compressor > sink,
+		     const std::string& filename)
+    : std::ostream(NULL), _filename(filename), _buf(std::move(sink)) {
+    rdbuf(&_buf);
+  }
+  ~CompressingOStream() {
+    if (!_buf.close()) {
+      std::cerr << "!! Could not finish writing " << _filename << std::endl;
+    }
+  }
+};
+
+}
+
+Compression compressionOf(const std::string& filename)
+{
+  if (endsWith(filename, ".gz")) {
+    return GZIP;
+  }
+  if (endsWith(filename, ".zst")) {
+    return ZSTD;
+  }
+  return UNCOMPRESSED;
+}
+
+std::unique_ptr< std::istream > openInput(const std::string& filename)
+{
+  std::unique_ptr< Decompressor > source;
+  if (filename == "-") {
+    return std::unique_ptr< std::istream >(new std::ifstream("/dev/stdin"));
+  }
+  switch (compressionOf(filename)) {
+  case UNCOMPRESSED:
+    return std::unique_ptr< std::istream >(new std::ifstream(filename.c_str()));
+  case GZIP:
+    if (gzFile file = gzopen(filename.c_str(), "rb")) {
+      source.reset(new GzipDecompressor(file));
+    }
+    break;
+  case ZSTD:
+    checkZstd();
+#ifdef PARADIGM_WITH_ZSTD
+    if (FILE* file = fopen(filename.c_str(), "rb")) {
+      source.reset(new ZstdDecompressor(file, filename));
+    }
+#endif
+    break;
+  }
+  if (!source) {
+    return std::unique_ptr< std::istream >(new std::istream(NULL));
+  }
+  return std::unique_ptr< std::istream >(new DecompressingIStream(std::move(source)));
+}
+
+std::unique_ptr< std::ostream > openOutput(const std::string& filename)
+{
+  std::unique_ptr< Compressor > sink;
+  switch (compressionOf(filename)) {
+  case UNCOMPRESSED:
+    return std::unique_ptr< std::ostream >(new std::ofstream(filename.c_str()));
+  case GZIP:
+    if (gzFile file = gzopen(filename.c_str(), "wb6")) {
+      sink.reset(new GzipCompressor(file));
+    }
+    break;
+  case ZSTD:
+    checkZstd();
+#ifdef PARADIGM_WITH_ZSTD
+    if (FILE* file = fopen(filename.c_str(), "wb")) {
+      sink.reset(new ZstdCompressor(file));
+    }
+#endif
+    break;
+  }
+  if (!sink) {
+    return std::unique_ptr< std::ostream >(new std::ostream(NULL));
+  }
+  return std::unique_ptr< std::ostream >(new CompressingOStream(std::move(sink),
+								 filename));
+}
+
+TextContents::TextContents(const std::string& filename)
+{
+  if (compressionOf(filename) == UNCOMPRESSED && filename != "-"
+      && MappedFile::isRegular(filename)) {
+    _mapped.reset(new MappedFile(filename));
+    return;
+  }
+  std::unique_ptr< std::istream > in = openInput(filename);
+  if (!*in) {
+    THROW("Could not open " + filename);
+  }
+  std::vector< char > block(BLOCK_SIZE);
+  while (in->read(block.data(), block.size()) || in->gcount() > 0) {
+    _text.append(block.data(), in->gcount());
+  }
+}
+
+const char* TextContents::data() const
+{
+  return _mapped ? _mapped->data() : _text.data();
+}
+
+size_t TextContents::size() const
+{
+  return _mapped ? _mapped->size() : _text.size();
+}
@@ -0,0 +1,56 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_COMPRESSEDIO_H
+#define HEADER_COMPRESSEDIO_H
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+class MappedFile;
+
+/// How a file is compressed, chosen by its extension: ".gz" for gzip and
+/// ".zst" for zstd, which needs a build with WITH_ZSTD=1
+enum Compression { UNCOMPRESSED, GZIP, ZSTD };
+Compression compressionOf(const std::string& filename);
+
+/// Opens \a filename for reading.  Compressed files are decompressed on a
+/// separate thread a few blocks ahead of the reader, and decompression
+/// errors are thrown from the read.  The stream is in a failed state if
+/// the file can not be opened.  "-" opens standard input, uncompressed.
+std::unique_ptr< std::istream > openInput(const std::string& filename);
+
+/// Opens \a filename for writing, compressed according to its extension.
+/// The compressed data is finished when the stream is deleted, and
+/// flush() makes everything written so far readable.  The stream is in
+/// a failed state if the file can not be created.
+std::unique_ptr< std::ostream > openOutput(const std::string& filename);
+
+/// The whole contents of a text file: mapped in place when the file is
+/// plain and regular, otherwise decompressed or read from the pipe into
+/// memory
+class TextContents
+{
+private:
+  std::shared_ptr< const MappedFile > _mapped;
+  std::string _text;
+
+public:
+  TextContents(const std::string& filename);
+
+  TextContents(const TextContents& x) = delete;
+  TextContents& operator=(const TextContents& x) = delete;
+
+  const char* data() const;
+  size_t size() const;
+  const char* end() const { return data() + size(); }
+};
+
+#endif
@@ -6,6 +6,8 @@
 /*	Five3 Genomics, LLC (http://five3genomics.com).								*/
 /********************************************************************************/
 
+#include <dai/emalg.h>
+
 #include "configuration.h"
 
 const std::string RunConfiguration::INFERENCE_CONF_TOKEN("inference");
@@ -13,6 +15,7 @@ const std::string RunConfiguration::EVIDENCE_CONF_TOKEN("evidence");
 const std::string RunConfiguration::PATHWAY_CONF_TOKEN("pathway");
 const std::string RunConfiguration::EM_STEP_CONF_TOKEN("em_step");
 const std::string RunConfiguration::EM_CONF_TOKEN("em");
+const std::string RunConfiguration::OUTPUT_CONF_TOKEN("output");
 
 const std::string RunConfiguration::INFERENCE_MATCH_TOKEN("pathway_match");
 
@@ -70,11 +73,20 @@ RunConfiguration::addConfigurations(std::istream& is)
 	_em = conf;
       } else if (type == PATHWAY_CONF_TOKEN) {
 	_path = conf;
+      } else if (type == OUTPUT_CONF_TOKEN) {
+	_output = conf;
       } else {
 	THROW("Expecting an inference or evidence token in conf file");
       }
     }
 }
 
+size_t RunConfiguration::emMaxIters() const
+{
+  if (!_em.hasKey("max_iters"))
+    return EMAlg::MAX_ITERS_DEFAULT;
+  return _em.getStringAs<size_t>("max_iters");
+}
+
 size_t RunConfiguration::evidenceSize() {return _evidences.size();}
 PropertySet& RunConfiguration::evidence(size_t i) {return _evidences.at(i);}
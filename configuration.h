@@ -27,6 +27,7 @@ public:
   static const std::string PATHWAY_CONF_TOKEN;
   static const std::string EM_STEP_CONF_TOKEN;
   static const std::string EM_CONF_TOKEN;
+  static const std::string OUTPUT_CONF_TOKEN;
 
   static const std::string INFERENCE_MATCH_TOKEN;
 
@@ -39,12 +40,14 @@ private:
   EMSteps _emsteps;
   PropertySet _em;
   PropertySet _path;
+  PropertySet _output;
 
 public:
 
   /// Default constructor
-  RunConfiguration() : _inferences(), _evidences(), _emsteps(), _em(), _path(){
-    _em.set("max_iters", 0);
+  RunConfiguration() : _inferences(), _evidences(), _emsteps(), _em(), _path(),
+		       _output() {
+    _em.set("max_iters", std::string("0"));
   }
 
   /// Copy constructor
@@ -53,7 +56,8 @@ public:
     _evidences(x._evidences),
     _emsteps(x._emsteps),
     _em(x._em),
-    _path(x._path)
+    _path(x._path),
+    _output(x._output)
   {}
 
   /// Assignment operator
@@ -64,6 +68,7 @@ public:
       _emsteps = x._emsteps;
       _em = x._em;
       _path = x._path;
+      _output = x._output;
     }
     return *this;
   }
@@ -78,11 +83,18 @@ public:
   PropertySet& evidence(size_t i);
 
   PropertySet& pathwayProps() {return _path;}
+  const PropertySet& pathwayProps() const {return _path;}
 
   size_t evidenceSize();
 
   const PropertySet& emProps() { return _em; }
 
+  /// The output [...] block, e.g. output [format=binary]
+  const PropertySet& outputProps() const { return _output; }
+
+  /// The em [max_iters] setting; zero means EM is disabled
+  size_t emMaxIters() const;
+
   const EMSteps emSteps() const {return _emsteps;}
 };
 
@@ -0,0 +1,64 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "discretizer.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+Discretizer::Discretizer(const std::vector< double >& cutoffs)
+  : _cutoffs(cutoffs), _thresholds(), _sorted(true)
+{
+  if (cutoffs.size() >= NA) {
+    THROW("Too many discretization cutoffs");
+  }
+  for (size_t i = 0; i < cutoffs.size(); ++i) {
+    // a float x is below cutoffs[i] exactly when it is below t
+    float t = (float)cutoffs[i];
+    if ((double)t < cutoffs[i]) {
+      t = nextafterf(t, INFINITY);
+    }
+    _thresholds.push_back(t);
+    if (i > 0 && !(cutoffs[i - 1] <= cutoffs[i])) {
+      _sorted = false;
+    }
+  }
+}
+
+unsigned char Discretizer::state(float x) const
+{
+  size_t i = 0;
+  while (i < _cutoffs.size() && !(x < _cutoffs[i])) {
+    ++i;
+  }
+  return i;
+}
+
+void Discretizer::states(const float* x, size_t n, unsigned char* out) const
+{
+  if (!_sorted) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = std::isnan(x[i]) ? NA : state(x[i]);
+    }
+    return;
+  }
+  std::fill(out, out + n, 0);
+  for (size_t k = 0; k < _thresholds.size(); ++k) {
+    const float t = _thresholds[k];
+    for (size_t i = 0; i < n; ++i) {
+      out[i] += x[i] >= t;
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = x[i] != x[i] ? NA : out[i];
+  }
+}
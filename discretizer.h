@@ -0,0 +1,45 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_DISCRETIZER_H
+#define HEADER_DISCRETIZER_H
+
+#include <cstddef>
+#include <vector>
+
+/// Maps evidence values to states with the evidence disc cutoffs: the
+/// state of x is the index of the first cutoff that x is below, or the
+/// number of cutoffs.  Values are compared as floats, as they always
+/// have been, against the smallest float not below each cutoff, which
+/// gives exactly the double comparison.
+class Discretizer
+{
+public:
+  static constexpr unsigned char NA = 0xFF; // state of a missing value
+
+private:
+  std::vector< double > _cutoffs;
+  std::vector< float > _thresholds;
+  bool _sorted;
+
+public:
+  Discretizer(const std::vector< double >& cutoffs=std::vector< double >());
+
+  const std::vector< double >& cutoffs() const { return _cutoffs; }
+
+  unsigned char state(float x) const;
+
+  /// Discretizes \a n values at once; NaN values become NA.  With
+  /// ascending cutoffs the state is a count of the thresholds at or
+  /// below x, computed one threshold at a time over the whole block so
+  /// that the compiler vectorizes it; other cutoffs use state().
+  void states(const float* x, size_t n, unsigned char* out) const;
+};
+
+#endif
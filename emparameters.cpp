@@ -0,0 +1,274 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <cstring>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "emparameters.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+const std::string EmParameterFile::EXTENSION = ".emb";
+
+namespace {
+
+const char MAGIC[8] = { 'P', 'D', 'G', 'M', 'E', 'M', 'P', '\0' };
+const unsigned int FORMAT_VERSION = 1;
+
+/// The labels as one string, for looking tables up
+string signatureKey(const vector< string >& signature)
+{
+  string key;
+  for (size_t i = 0; i < signature.size(); ++i) {
+    key += signature[i];
+    key += '\t';
+  }
+  return key;
+}
+
+/// The signature and dimensions of a group of shared parameters, taken
+/// from its first factor as outputEmInferredParams does
+void groupSignature(const PathwayTab& pathway, const vector< Var >& vars,
+		    vector< string >& signature, vector< size_t >& dims)
+{
+  signature.clear();
+  dims.clear();
+  for (size_t vi = 0; vi < vars.size(); ++vi) {
+    dims.push_back(vars[vi].states());
+    if (vi == 0) {
+      signature.push_back(pathway.getNode(vars[vi].label()).second);
+    } else {
+      signature.push_back(pathway.getInteraction(vars[0].label(),
+						 vars[vi].label()));
+    }
+  }
+}
+
+}
+
+struct EmParameterFile::Header {
+  char magic[8];
+  unsigned int version;
+  unsigned int reserved;
+  unsigned long long iterations;
+  double logZ;
+  unsigned long long tables;
+  unsigned long long vars;
+  unsigned long long values;
+  unsigned long long label_bytes;
+};
+
+namespace {
+
+/// Sections in file order: the first variable and first value of each
+/// table, the dimensions, the label table, then the values
+size_t layoutSize(const EmParameterFile::Header& h)
+{
+  size_t n = alignSection(sizeof(EmParameterFile::Header));
+  n += 2 * alignSection((h.tables + 1) * sizeof(unsigned long long));
+  n += alignSection(h.vars * sizeof(unsigned long long));
+  n += alignSection((h.vars + 1) * sizeof(unsigned long long));
+  n += alignSection(h.label_bytes);
+  n += alignSection(h.values * sizeof(double));
+  return n;
+}
+
+}
+
+vector< ParameterTable >
+parameterTables(const FactorGraph& fg, const PathwayTab& pathway,
+		const vector< vector < SharedParameters::FactorOrientations > >&
+		var_orders)
+{
+  vector< ParameterTable > tables;
+  for (size_t i = 0; i < var_orders.size(); ++i) {
+    for (size_t j = 0; j < var_orders[i].size(); ++j) {
+      if (var_orders[i][j].empty()) {
+	continue; // an em_step sub-type that matched no nodes
+      }
+      SharedParameters::FactorOrientations::const_iterator fo
+	= var_orders[i][j].begin();
+      tables.push_back(ParameterTable());
+      ParameterTable& t = tables.back();
+      groupSignature(pathway, fo->second, t.signature, t.dims);
+
+      Permute perm(fo->second);
+      const Factor& f = fg.factor(fo->first);
+      for (multifor s(t.dims); s.valid(); ++s) {
+	t.values.push_back(f[perm.convertLinearIndex((size_t)s)]);
+      }
+    }
+  }
+  return tables;
+}
+
+void writeEmParameters(const string& filename, size_t iterations, double logZ,
+		       const vector< ParameterTable >& tables)
+{
+  vector< unsigned long long > tableVars(1, 0);
+  vector< unsigned long long > tableValues(1, 0);
+  vector< unsigned long long > dims;
+  vector< unsigned long long > labelOffsets(1, 0);
+  string labels;
+  vector< double > values;
+  for (size_t t = 0; t < tables.size(); ++t) {
+    for (size_t v = 0; v < tables[t].dims.size(); ++v) {
+      dims.push_back(tables[t].dims[v]);
+      labels += tables[t].signature[v];
+      labelOffsets.push_back(labels.size());
+    }
+    values.insert(values.end(), tables[t].values.begin(),
+		  tables[t].values.end());
+    tableVars.push_back(dims.size());
+    tableValues.push_back(values.size());
+  }
+
+  EmParameterFile::Header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = FORMAT_VERSION;
+  h.iterations = iterations;
+  h.logZ = logZ;
+  h.tables = tables.size();
+  h.vars = dims.size();
+  h.values = values.size();
+  h.label_bytes = labels.size();
+
+  AtomicOutputFile file(filename);
+  SectionWriter w(file.stream());
+  w.put(&h, 1);
+  w.put(tableVars);
+  w.put(tableValues);
+  w.put(dims);
+  w.put(labelOffsets);
+  w.put(labels.data(), labels.size());
+  w.put(values);
+  file.commit();
+}
+
+EmParameterFile::EmParameterFile(const std::string& filename)
+  : _file(filename),
+    _header(reinterpret_cast< const Header* >(_file.data())),
+    _tableVars(NULL),
+    _tableValues(NULL),
+    _dims(NULL),
+    _labelOffsets(NULL),
+    _labels(NULL),
+    _values(NULL),
+    _index()
+{
+  if (_file.size() < sizeof(Header)
+      || memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0
+      || _header->version != FORMAT_VERSION
+      || _file.size() != layoutSize(*_header)) {
+    THROW("Not a valid EM parameter file: " + filename);
+  }
+  SectionReader r(_file.data());
+  r.take< Header >(1);
+  _tableVars = r.take< unsigned long long >(_header->tables + 1);
+  _tableValues = r.take< unsigned long long >(_header->tables + 1);
+  _dims = r.take< unsigned long long >(_header->vars);
+  _labelOffsets = r.take< unsigned long long >(_header->vars + 1);
+  _labels = r.take< char >(_header->label_bytes);
+  _values = r.take< double >(_header->values);
+
+  if (_tableVars[_header->tables] != _header->vars
+      || _tableValues[_header->tables] != _header->values
+      || _labelOffsets[_header->vars] != _header->label_bytes) {
+    THROW("Not a valid EM parameter file: " + filename);
+  }
+  vector< string > signature;
+  for (size_t t = 0; t < tables(); ++t) {
+    if (_tableVars[t + 1] < _tableVars[t]) {
+      THROW("Not a valid EM parameter file: " + filename);
+    }
+    size_t states = 1;
+    signature.clear();
+    for (size_t v = _tableVars[t]; v < _tableVars[t + 1]; ++v) {
+      if (_labelOffsets[v + 1] < _labelOffsets[v]) {
+	THROW("Not a valid EM parameter file: " + filename);
+      }
+      states *= _dims[v];
+      signature.push_back(string(_labels + _labelOffsets[v],
+				 _labelOffsets[v + 1] - _labelOffsets[v]));
+    }
+    if (_tableValues[t + 1] - _tableValues[t] != states) {
+      THROW("Not a valid EM parameter file: " + filename);
+    }
+    _index.emplace(signatureKey(signature), t);
+  }
+}
+
+size_t EmParameterFile::iterations() const
+{
+  return _header->iterations;
+}
+
+double EmParameterFile::logZ() const
+{
+  return _header->logZ;
+}
+
+size_t EmParameterFile::tables() const
+{
+  return _header->tables;
+}
+
+size_t EmParameterFile::find(const vector< string >& signature) const
+{
+  unordered_map< string, size_t >::const_iterator i
+    = _index.find(signatureKey(signature));
+  return i == _index.end() ? NONE : i->second;
+}
+
+void applyEmParameters(const EmParameterFile& params,
+		       const PathwayTab& pathway,
+		       const vector< vector < SharedParameters::FactorOrientations > >&
+		       var_orders,
+		       vector< Factor >& factors)
+{
+  vector< string > signature;
+  vector< size_t > dims;
+  for (size_t i = 0; i < var_orders.size(); ++i) {
+    for (size_t j = 0; j < var_orders[i].size(); ++j) {
+      if (var_orders[i][j].empty()) {
+	continue;
+      }
+      groupSignature(pathway, var_orders[i][j].begin()->second, signature,
+		     dims);
+      size_t t = params.find(signature);
+      if (t == EmParameterFile::NONE) {
+	cerr << "!! No learned parameters for child='" << signature[0] << "'";
+	for (size_t e = 1; e < signature.size(); ++e) {
+	  cerr << " edge" << e << "='" << signature[e] << "'";
+	}
+	cerr << ", keeping the configured ones" << endl;
+	continue;
+      }
+      bool fits = params.vars(t) == dims.size();
+      for (size_t v = 0; fits && v < dims.size(); ++v) {
+	fits = params.dim(t, v) == dims[v];
+      }
+      if (!fits) {
+	THROW("Learned parameters for child='" + signature[0]
+	      + "' have other dimensions");
+      }
+
+      const double* values = params.values(t);
+      for (SharedParameters::FactorOrientations::const_iterator fo
+	     = var_orders[i][j].begin(); fo != var_orders[i][j].end(); ++fo) {
+	Permute perm(fo->second);
+	Factor& f = factors[fo->first];
+	for (multifor s(dims); s.valid(); ++s) {
+	  f.set(perm.convertLinearIndex((size_t)s), values[(size_t)s]);
+	}
+      }
+    }
+  }
+}
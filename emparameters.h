@@ -0,0 +1,90 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_EMPARAMETERS_H
+#define HEADER_EMPARAMETERS_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dai/factorgraph.h>
+
+#include "mappedfile.h"
+#include "pathwaytab.h"
+
+/// The learned parameters of one em_step group, as outputEmInferredParams
+/// prints them: the child's sub-type followed by the label of each edge,
+/// the number of states of the child and of each parent, and the values
+/// over their joint states with the child's state varying fastest
+struct ParameterTable
+{
+  vector< string > signature;
+  vector< size_t > dims;
+  vector< double > values;
+};
+
+/// A table for each group of shared parameters, read from the factors
+/// of \a fg
+vector< ParameterTable >
+parameterTables(const FactorGraph& fg, const PathwayTab& pathway,
+		const vector< vector < SharedParameters::FactorOrientations > >&
+		var_orders);
+
+/// Writes \a tables as an EmParameterFile, replacing \a filename
+/// atomically, so it is cheap enough to checkpoint every EM iteration
+void writeEmParameters(const string& filename, size_t iterations, double logZ,
+		       const vector< ParameterTable >& tables);
+
+/// Learned EM parameters in binary form (-e file.emb): a header with
+/// the iteration count and logZ, then per table its signature, its
+/// dimensions and a float64 array, all in 8 byte aligned sections of a
+/// read-only mapping
+class EmParameterFile
+{
+public:
+  struct Header;
+  static const std::string EXTENSION; // = ".emb"
+  static const size_t NONE = size_t(-1);
+
+private:
+  MappedFile _file;
+  const Header* _header;
+  const unsigned long long* _tableVars;
+  const unsigned long long* _tableValues;
+  const unsigned long long* _dims;
+  const unsigned long long* _labelOffsets;
+  const char* _labels;
+  const double* _values;
+  unordered_map< string, size_t > _index;
+
+public:
+  /// Maps \a filename, throwing if it is not a valid parameter file
+  EmParameterFile(const std::string& filename);
+
+  size_t iterations() const;
+  double logZ() const;
+  size_t tables() const;
+
+  /// Table \a t, or NONE, whose signature is \a signature
+  size_t find(const vector< string >& signature) const;
+  size_t vars(size_t t) const { return _tableVars[t + 1] - _tableVars[t]; }
+  size_t dim(size_t t, size_t v) const { return _dims[_tableVars[t] + v]; }
+  const double* values(size_t t) const { return _values + _tableValues[t]; }
+};
+
+/// Sets the factors of each group of shared parameters to its table in
+/// \a params, warning about the groups that have none, which keep their
+/// configured values; throws if a table's dimensions do not fit
+void applyEmParameters(const EmParameterFile& params,
+		       const PathwayTab& pathway,
+		       const vector< vector < SharedParameters::FactorOrientations > >&
+		       var_orders,
+		       vector< Factor >& factors);
+
+#endif
@@ -0,0 +1,245 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "compressedio.h"
+#include "evidencematrix.h"
+#include "tabtokenizer.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+using namespace std;
+
+const std::string EvidenceMatrix::EXTENSION = ".evb";
+
+double parseEvidence(const char* begin, const char* end)
+{
+  const char* p = begin;
+  while (p != end && isspace((unsigned char)*p)) {
+    ++p;
+  }
+  if (p != end && *p == '+' && p + 1 != end && p[1] != '-') {
+    ++p;
+  }
+  double result;
+  from_chars_result r = from_chars(p, end, result);
+  if (r.ec != errc() || r.ptr != end || !isfinite(result)) {
+    THROW("String " + string(begin, end) + " can not be converted to double.");
+  }
+  return result;
+}
+
+namespace {
+
+const char MAGIC[8] = { 'P', 'D', 'G', 'M', 'E', 'V', 'B', '\0' };
+const unsigned int FORMAT_VERSION = 1;
+const unsigned char PACKED_NA = 3; // 2-bit code of a missing value
+
+}
+
+struct EvidenceMatrix::Header {
+  char magic[8];
+  unsigned int version;
+  unsigned int discretized; // 0: float32 values, 1: 2-bit states
+  unsigned long long samples;
+  unsigned long long genes;
+  unsigned long long cutoffs;
+  unsigned long long sample_bytes;
+  unsigned long long gene_bytes;
+};
+
+namespace {
+
+size_t columnBytes(const EvidenceMatrix::Header& h) {
+  return h.discretized ? (h.samples + 3) / 4 : h.samples * sizeof(float);
+}
+
+size_t layoutSize(const EvidenceMatrix::Header& h) {
+  size_t n = alignSection(sizeof(EvidenceMatrix::Header));
+  n += alignSection((h.samples + 1) * sizeof(unsigned long long));
+  n += alignSection(h.sample_bytes);
+  n += alignSection((h.genes + 1) * sizeof(unsigned long long));
+  n += alignSection(h.gene_bytes);
+  n += alignSection(h.cutoffs * sizeof(double));
+  n += h.genes * alignSection(columnBytes(h));
+  return n;
+}
+
+/// True if no count is larger than the file, so layoutSize can not
+/// overflow
+bool countsFit(const EvidenceMatrix::Header& h, size_t size) {
+  return h.samples <= size && h.genes <= size && h.cutoffs <= size
+    && h.sample_bytes <= size && h.gene_bytes <= size
+    && (h.genes == 0 || alignSection(columnBytes(h)) <= size / h.genes);
+}
+
+}
+
+EvidenceMatrix::EvidenceMatrix(const std::string& filename)
+  : _file(filename, MappedFile::RANDOM),
+    _header(reinterpret_cast< const Header* >(_file.data())),
+    _sampleOffsets(NULL),
+    _sampleNames(NULL),
+    _geneOffsets(NULL),
+    _geneNames(NULL),
+    _cutoffs(),
+    _columns(NULL),
+    _columnStride(0)
+{
+  if (_file.size() < sizeof(Header)
+      || memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0
+      || _header->version != FORMAT_VERSION
+      || !countsFit(*_header, _file.size())
+      || _file.size() != layoutSize(*_header)) {
+    THROW("Not a valid evidence matrix: " + filename);
+  }
+  SectionReader r(_file.data());
+  r.take< Header >(1);
+  _sampleOffsets = r.take< unsigned long long >(_header->samples + 1);
+  _sampleNames = r.take< char >(_header->sample_bytes);
+  _geneOffsets = r.take< unsigned long long >(_header->genes + 1);
+  _geneNames = r.take< char >(_header->gene_bytes);
+  const double* cutoffs = r.take< double >(_header->cutoffs);
+  if (_header->discretized) {
+    _cutoffs.assign(cutoffs, cutoffs + _header->cutoffs);
+  }
+  _columns = r.take< char >(0);
+  _columnStride = alignSection(columnBytes(*_header));
+
+  if (!validOffsets(_sampleOffsets, _header->samples, _header->sample_bytes)
+      || !validOffsets(_geneOffsets, _header->genes, _header->gene_bytes)) {
+    THROW("Not a valid evidence matrix: " + filename);
+  }
+}
+
+size_t EvidenceMatrix::samples() const
+{
+  return _header->samples;
+}
+
+size_t EvidenceMatrix::genes() const
+{
+  return _header->genes;
+}
+
+void EvidenceMatrix::states(size_t column, unsigned char* out) const
+{
+  for (size_t r = 0; r < _header->samples; ++r) {
+    out[r] = state(column, r);
+  }
+}
+
+unsigned char EvidenceMatrix::state(size_t column, size_t row) const
+{
+  const unsigned char* packed =
+    reinterpret_cast< const unsigned char* >(_columns + column * _columnStride);
+  unsigned char code = (packed[row / 4] >> (2 * (row % 4))) & 3;
+  return code == PACKED_NA ? Discretizer::NA : code;
+}
+
+void EvidenceMatrix::convert(const std::string& tab_filename,
+			     const std::string& evb_filename,
+			     const vector< double >* cutoffs)
+{
+  if (cutoffs != NULL && (cutoffs->empty() || cutoffs->size() > 2)) {
+    THROW("Discretized evidence matrices need one or two cutoffs");
+  }
+
+  TextContents tab(tab_filename);
+  const char* header_end = find(tab.data(), tab.end(), '\n');
+  vector< string_view > fields;
+  TabTokenizer header(tab.data(), header_end);
+  header.next(fields);
+  vector< string > genes;
+  for (size_t h = 1; h < fields.size(); ++h) {
+    genes.push_back(string(fields[h]));
+  }
+
+  // rows are parsed in order and kept row-major until every row is read
+  vector< string > samples;
+  vector< float > values;
+  const float missing = numeric_limits< float >::quiet_NaN();
+  const char* rows = header_end == tab.end() ? header_end : header_end + 1;
+  TabTokenizer lines(rows, tab.end());
+  while (lines.next(fields)) {
+    samples.push_back(fields.empty() ? string() : string(fields[0]));
+    if (fields.size() > genes.size() + 1) {
+      THROW("Entries in evidence line does not match header length");
+    }
+    for (size_t c = 0; c < genes.size(); ++c) {
+      string_view f = c + 1 < fields.size() ? fields[c + 1] : string_view();
+      values.push_back(f.empty() || f == "NA" ? missing
+		       : (float)parseEvidence(f.data(), f.data() + f.size()));
+    }
+  }
+
+  Header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = FORMAT_VERSION;
+  h.discretized = cutoffs != NULL;
+  h.samples = samples.size();
+  h.genes = genes.size();
+  h.cutoffs = cutoffs != NULL ? cutoffs->size() : 0;
+
+  vector< unsigned long long > sample_offsets(1, 0);
+  string sample_names;
+  for (size_t r = 0; r < samples.size(); ++r) {
+    sample_names += samples[r];
+    sample_offsets.push_back(sample_names.size());
+  }
+  h.sample_bytes = sample_names.size();
+  vector< unsigned long long > gene_offsets(1, 0);
+  string gene_names;
+  for (size_t c = 0; c < genes.size(); ++c) {
+    gene_names += genes[c];
+    gene_offsets.push_back(gene_names.size());
+  }
+  h.gene_bytes = gene_names.size();
+
+  AtomicOutputFile out(evb_filename);
+  SectionWriter w(out.stream());
+  w.put(&h, 1);
+  w.put(sample_offsets);
+  w.put(sample_names.data(), sample_names.size());
+  w.put(gene_offsets);
+  w.put(gene_names.data(), gene_names.size());
+  if (cutoffs != NULL) {
+    w.put(*cutoffs);
+  }
+  vector< float > column(h.samples);
+  vector< unsigned char > states(h.samples);
+  vector< unsigned char > packed((h.samples + 3) / 4);
+  Discretizer discretizer(cutoffs != NULL ? *cutoffs : vector< double >());
+  for (size_t c = 0; c < h.genes; ++c) {
+    for (size_t r = 0; r < h.samples; ++r) {
+      column[r] = values[r * h.genes + c];
+    }
+    if (cutoffs == NULL) {
+      w.put(column);
+      continue;
+    }
+    discretizer.states(column.data(), h.samples, states.data());
+    fill(packed.begin(), packed.end(), 0);
+    for (size_t r = 0; r < h.samples; ++r) {
+      unsigned char code = states[r] == Discretizer::NA ? PACKED_NA : states[r];
+      packed[r / 4] |= code << (2 * (r % 4));
+    }
+    w.put(packed);
+  }
+  out.commit();
+}
@@ -0,0 +1,86 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_EVIDENCEMATRIX_H
+#define HEADER_EVIDENCEMATRIX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "discretizer.h"
+#include "mappedfile.h"
+
+/// Parses one evidence cell like istream >> double: leading white space
+/// and a '+' sign are allowed, anything after the number is an error
+double parseEvidence(const char* begin, const char* end);
+
+/// A binary, column-major copy of a text evidence file (file.tab.evb),
+/// mapped read-only so that a pathway job only touches the pages of the
+/// genes it uses.  Columns hold either float32 values, NaN where the
+/// text had NA, or 2-bit states already discretized with fixed cutoffs.
+class EvidenceMatrix
+{
+public:
+  static const std::string EXTENSION; // = ".evb"
+
+  struct Header;
+
+private:
+  MappedFile _file;
+  const Header* _header;
+  const unsigned long long* _sampleOffsets;
+  const char* _sampleNames;
+  const unsigned long long* _geneOffsets;
+  const char* _geneNames;
+  std::vector< double > _cutoffs;
+  const char* _columns;
+  size_t _columnStride;
+
+public:
+  /// Maps \a filename for reads of single columns, throwing if it is
+  /// not a valid matrix
+  EvidenceMatrix(const std::string& filename);
+
+  /// Converts the text evidence file \a tab_filename.  Values are stored
+  /// as float32 when \a cutoffs is NULL, otherwise as states, which
+  /// needs at most two cutoffs.
+  static void convert(const std::string& tab_filename,
+		      const std::string& evb_filename,
+		      const std::vector< double >* cutoffs);
+
+  size_t samples() const;
+  std::string_view sample(size_t row) const {
+    return std::string_view(_sampleNames + _sampleOffsets[row],
+			    _sampleOffsets[row + 1] - _sampleOffsets[row]);
+  }
+  size_t genes() const;
+  std::string_view gene(size_t column) const {
+    return std::string_view(_geneNames + _geneOffsets[column],
+			    _geneOffsets[column + 1] - _geneOffsets[column]);
+  }
+
+  /// True when columns hold states rather than values
+  bool discretized() const { return !_cutoffs.empty(); }
+  const std::vector< double >& cutoffs() const { return _cutoffs; }
+
+  /// The values of \a column; only valid when !discretized()
+  const float* values(size_t column) const {
+    return reinterpret_cast< const float* >(_columns + column * _columnStride);
+  }
+
+  /// Unpacks the states of \a column into \a out, Discretizer::NA where
+  /// missing;
+  /// only valid when discretized()
+  void states(size_t column, unsigned char* out) const;
+  /// The state of one cell; only valid when discretized()
+  unsigned char state(size_t column, size_t row) const;
+};
+
+#endif
@@ -6,10 +6,18 @@
 /*	Five3 Genomics, LLC (http://five3genomics.com).								*/
 /********************************************************************************/
 
+#include <algorithm>
+#include <cmath>
+#include <exception>
 #include <fstream>
+#include <stdexcept>
 
 #include "common.h"
+#include "compressedio.h"
+#include "evidencematrix.h"
 #include "evidencesource.h"
+#include "mappedfile.h"
+#include "tabtokenizer.h"
 
 #define THROW(msg) throw std::runtime_error(msg)
 
@@ -91,9 +99,14 @@ void EvidenceFactorGen::generateValues(const vector< string >& edge_types,
 
 EvidenceSource::EvidenceSource(PropertySet &p, string base) :
   cutoffs(),
+  _discretizer(),
   options(p),
   attachPoint(),
-  _evidenceFile()
+  _evidenceFile(),
+  _columns(),
+  _usedColumns(0),
+  _staged(false),
+  _streamRow(0)
 {
   if (p.hasKey("disc"))
     setCutoffs(p.getAs<string>("disc"));
@@ -111,6 +124,10 @@ EvidenceSource::EvidenceSource(PropertySet &p, string base) :
   } else {
     THROW("EvidenceSource conf. is missing the required property \"suffix\"");
   }
+
+  // the suffix still names the observations, whatever file is read
+  if (p.hasKey("input"))
+    _evidenceFile = p.getAs<string>("input");
 }
 
 void EvidenceSource::setCutoffs(string discLimits)
@@ -123,91 +140,355 @@ void EvidenceSource::setCutoffs(string discLimits)
 		  cerr << "Added cutoff " << atof(cutoffsStr[i].c_str()) << endl;
       cutoffs.push_back(atof(cutoffsStr[i].c_str()));
     }
+  _discretizer = Discretizer(cutoffs);
 }
 
-int EvidenceSource::discCutoffs  (float x)
+int EvidenceSource::discCutoffs  (float x) const
 {
-  if(cutoffs.size() == 0)
-    return 0;
-  if(x < cutoffs[0])
-    return 0;
-  size_t i = 1;
-  while (i < cutoffs.size())
-    {
-      if (x < cutoffs[i])
-	return i;
-      i++;
+  return _discretizer.state(x);
+}
+
+void EvidenceSource::planColumns(const PathwayTab& p,
+				 const vector< string_view >& genes)
+{
+  _columns.clear();
+  _usedColumns = 0;
+  for (size_t h = 0; h < genes.size(); h++) {
+    EvidenceColumn c;
+    c.gene = string(genes[h]);
+    c.column = 0;
+    c.skip = p.getEntityType(c.gene) != "protein"; // not in the pathway
+    if (!c.skip) {
+      _usedColumns = _columns.size() + 1;
     }
-  return i;
+    _columns.push_back(c);
+  }
 }
 
-double stringToDouble(const string& s) {
-  stringstream ss(s);
-  double result;
-  if (!(ss >> result).eof()) {
-    THROW("String " + s + " can not be converted to double.");
+void EvidenceSource::parseRows(const char* begin, const char* end,
+			       EvidenceRows& out) const
+{
+  while (begin != end) {
+    const char* eol = find(begin, end, '\n');
+    const char* field = begin;
+    const char* tab = find(field, eol, '\t');
+    out.samples.push_back(string(field, tab));
+
+    // split only up to the last pathway column; the rest is counted
+    size_t c = 0;
+    for ( ; tab != eol && c < _usedColumns; ++c) {
+      field = tab + 1;
+      tab = find(field, eol, '\t');
+      if (_columns[c].skip || field == tab
+	  || string_view(field, tab - field) == "NA") {
+	continue;
+      }
+      out.columns.push_back(c);
+      out.values.push_back(parseEvidence(field, tab));
+    }
+    if (tab != eol) {
+      size_t trailing = count(tab, eol, '\t') - (eol[-1] == '\t' ? 1 : 0);
+      if (c + trailing > _columns.size()) {
+	THROW("Entries in evidence line does not match header length");
+      }
+    }
+    out.ends.push_back(out.values.size());
+    begin = eol == end ? end : eol + 1;
   }
-  return result;
+  out.states.resize(out.values.size());
+  _discretizer.states(out.values.data(), out.values.size(), out.states.data());
 }
 
-void EvidenceSource::loadFromFile(PathwayTab& p,
-				  map<string, size_t>& sampleMap,
-				  vector<Evidence::Observation>& sampleData)
+void EvidenceSource::decodeMatrix(EvidenceRows& out) const
 {
-  ifstream infile;
-  infile.open( _evidenceFile.c_str() );
-  if( infile.is_open() ) {
-    string line;
+  // decode the pathway columns, then lay them out row by row like the
+  // text parser
+  const EvidenceMatrix& m = *_matrix;
+  const size_t n = m.samples();
+  vector< vector< unsigned char > > states(_usedColumns);
+  for (size_t c = 0; c < _usedColumns; ++c) {
+    if (_columns[c].skip) {
+      continue;
+    }
+    states[c].resize(n);
+    if (m.discretized()) {
+      m.states(c, states[c].data());
+    } else {
+      _discretizer.states(m.values(c), n, states[c].data());
+    }
+  }
 
-    if(!getline(infile,line))
-      return;
-    vector<string> header;
-    Tokenize(line,header,"\t");
+  for (size_t r = 0; r < n; ++r) {
+    out.samples.push_back(string(m.sample(r)));
+    for (size_t c = 0; c < _usedColumns; ++c) {
+      if (_columns[c].skip || states[c][r] == Discretizer::NA) {
+	continue;
+      }
+      out.columns.push_back(c);
+      out.states.push_back(states[c][r]);
+    }
+    out.ends.push_back(out.states.size());
+  }
+}
+
+bool EvidenceSource::piped() const
+{
+  return _evidenceFile == "-" || (MappedFile::exists(_evidenceFile)
+				   && !MappedFile::isRegular(_evidenceFile));
+}
+
+shared_ptr< const EvidenceMatrix > EvidenceSource::upToDateMatrix() const
+{
+  if (piped()) {
+    return shared_ptr< const EvidenceMatrix >();
+  }
+  string binary = _evidenceFile + EvidenceMatrix::EXTENSION;
+  if (MappedFile::upToDate(binary, _evidenceFile)) {
+    shared_ptr< const EvidenceMatrix > m;
+    try {
+      m.reset(new EvidenceMatrix(binary));
+    } catch (const runtime_error& e) {
+      cerr << "!! " << e.what() << ", reading " << _evidenceFile
+	   << " instead" << endl;
+      return shared_ptr< const EvidenceMatrix >();
+    }
+    if (!m->discretized() || m->cutoffs() == cutoffs) {
+      if (VERBOSE)
+	cerr << "Using evidence matrix " << binary << endl;
+      return m;
+    }
+    cerr << "!! Ignoring " << binary
+	 << ", it was discretized with different cutoffs" << endl;
+  }
+  return shared_ptr< const EvidenceMatrix >();
+}
+
+void EvidenceSource::registerColumns(PathwayTab& p,
+				     ObservationMatrix& observations)
+{
+  for (size_t c = 0; c < _columns.size(); ++c) {
+    if (!_columns[c].skip) {
+      _columns[c].var = p.addObservationNode(_columns[c].gene, attachPoint,
+					     _suffix);
+      _columns[c].column = observations.addVar(_columns[c].var);
+    }
+  }
+
+  p.addFactorGenerator("protein", _suffix,
+		       make_shared< const EvidenceFactorGen >(options));
+}
+
+size_t EvidenceSource::stage(const PathwayTab& p, size_t chunks)
+{
+  _staged = false;
+  _text.reset();
+  _matrix.reset();
+  _bounds.clear();
+  _rows.clear();
+
+  _matrix = upToDateMatrix();
+  if (_matrix) {
+    vector< string_view > genes;
+    for (size_t c = 0; c < _matrix->genes(); ++c) {
+      genes.push_back(_matrix->gene(c));
+    }
+    planColumns(p, genes);
+    _staged = true;
+    _rows.resize(1);
+    return 1;
+  }
+
+  if (!piped() && !MappedFile::exists(_evidenceFile)) {
+    return 0;
+  }
+  shared_ptr< const TextContents > file(new TextContents(_evidenceFile));
+  if (file->size() == 0) {
+    return 0;
+  }
+  const char* header_end = find(file->data(), file->end(), '\n');
+  vector< string_view > header;
+  TabTokenizer t(file->data(), header_end);
+  t.next(header);
+  if (!header.empty()) {
     header.erase(header.begin());
+  }
+  planColumns(p, header);
+  _text = file;
+  _staged = true;
+
+  // split the rows into chunks of whole lines, parsed independently
+  const char* rows = header_end == file->end() ? header_end : header_end + 1;
+  chunks = max((size_t)1,
+	       min(chunks, (size_t)(file->end() - rows) / (1 << 20) + 1));
+  _bounds.push_back(rows);
+  for (size_t k = 1; k < chunks; ++k) {
+    const char* b = rows + (file->end() - rows) * k / chunks;
+    b = max(b, _bounds.back());
+    b = find(b, file->end(), '\n');
+    _bounds.push_back(b == file->end() ? b : b + 1);
+  }
+  _bounds.push_back(file->end());
+  _rows.resize(chunks);
+  return chunks;
+}
 
-    vector<Var> vars;
-    vars.reserve(header.size());
+void EvidenceSource::parseChunk(size_t k)
+{
+  if (_matrix) {
+    decodeMatrix(_rows[k]);
+  } else {
+    parseRows(_bounds[k], _bounds[k + 1], _rows[k]);
+  }
+}
 
-    for (size_t h = 0; h < header.size(); h++) {
-	  if(p.getEntityType(header[h]) == "protein") // skip adding evidence if it's not in the pathway
-	  {
-	      vars.push_back(p.addObservationNode(header[h], attachPoint, _suffix));
-	  }
+void EvidenceSource::commit(PathwayTab& p,
+			    map<string, size_t>& sampleMap,
+			    ObservationMatrix& observations)
+{
+  if (!_staged) {
+    return;
+  }
+  registerColumns(p, observations);
+
+  // a sample gets its row with its first observed cell
+  for (size_t k = 0; k < _rows.size(); ++k) {
+    const EvidenceRows& r = _rows[k];
+    size_t cell = 0;
+    for (size_t row = 0; row < r.samples.size(); ++row) {
+      const string& sample = r.samples[row];
+      _sampleNames.push_back(sample);
+      if (cell == r.ends[row]) {
+	continue;
+      }
+      // one lookup per sample, not per cell
+      map<string, size_t>::iterator s = sampleMap.lower_bound(sample);
+      if (s == sampleMap.end() || s->first != sample) {
+	s = sampleMap.insert(s, make_pair(sample, observations.addRow()));
+      }
+      const size_t sample_idx = s->second;
+      for ( ; cell < r.ends[row]; ++cell) {
+	observations.set(sample_idx, _columns[r.columns[cell]].column,
+			 r.states[cell]);
+      }
     }
+  }
+
+  _staged = false;
+  _text.reset();
+  _matrix.reset();
+  _bounds.clear();
+  _rows.clear();
+}
 
-    FactorGenerator* fgen = new EvidenceFactorGen(options);
-    p.addFactorGenerator("protein", _suffix, fgen);
+void EvidenceSource::openStream(PathwayTab& p,
+				ObservationMatrix& observations)
+{
+  _stream.reset();
+  _streamRow = 0;
+  _matrix = upToDateMatrix();
+  if (_matrix) {
+    vector< string_view > genes;
+    for (size_t c = 0; c < _matrix->genes(); ++c) {
+      genes.push_back(_matrix->gene(c));
+    }
+    planColumns(p, genes);
+  } else {
+    // like stage(), a missing or empty file has no columns and no rows
+    shared_ptr< istream > in(openInput(_evidenceFile));
+    if (!*in || !getline(*in, _line)) {
+      return;
+    }
+    vector< string_view > header;
+    TabTokenizer t(_line.data(), _line.data() + _line.size());
+    t.next(header);
+    if (!header.empty()) {
+      header.erase(header.begin());
+    }
+    planColumns(p, header);
+    _stream = in;
+  }
+  registerColumns(p, observations);
+}
 
-    while(getline(infile,line)) {
-      vector<string> vals;
-      Tokenize(line,vals,"\t");
-      if (vals.size() > header.size() + 1) {
-		THROW("Entries in evidence line does not match header length");
+bool EvidenceSource::nextRow(string& sample,
+			     ObservationMatrix& observations,
+			     size_t row)
+{
+  EvidenceRows& r = _streamed;
+  r.samples.clear();
+  r.ends.clear();
+  r.columns.clear();
+  r.values.clear();
+  r.states.clear();
+  if (_matrix) {
+    if (_streamRow == _matrix->samples()) {
+      return false;
+    }
+    sample = string(_matrix->sample(_streamRow));
+    for (size_t c = 0; c < _usedColumns; ++c) {
+      if (_columns[c].skip) {
+	continue;
       }
-      string sample = vals[0];
-      _sampleNames.push_back(sample);
-      vals.erase(vals.begin());
-
-      for(size_t i = 0; i < vals.size(); i++) {
-	if(p.getEntityType(header[i]) != "protein") // skip adding evidence if it's not in the pathway
-	  continue;
-	if(strcmp(vals[i].c_str(),"NA")==0)
-	  continue;
-
-	double evidence = stringToDouble(vals[i]);
-	if (sampleMap.count(sample) == 0) {
-	  sampleMap[sample] = sampleData.size();
-	  sampleData.push_back(Evidence::Observation());
-	}
-	size_t sample_idx = sampleMap[sample];
-	sampleData[sample_idx][vars[i]] = discCutoffs(evidence);
+      unsigned char state;
+      if (_matrix->discretized()) {
+	state = _matrix->state(c, _streamRow);
+      } else {
+	_discretizer.states(_matrix->values(c) + _streamRow, 1, &state);
+      }
+      if (state != Discretizer::NA) {
+	observations.set(row, _columns[c].column, state);
       }
     }
-    infile.close();
+    ++_streamRow;
+    return true;
+  }
+
+  if (!_stream || !getline(*_stream, _line)) {
+    return false;
   }
-  return;
+  parseRows(_line.data(), _line.data() + _line.size(), r);
+  sample = r.samples.empty() ? string() : r.samples[0]; // an empty line
+  for (size_t k = 0; k < r.states.size(); ++k) {
+    observations.set(row, _columns[r.columns[k]].column, r.states[k]);
+  }
+  return true;
 }
 
+void EvidenceSource::loadAll(vector<EvidenceSource>& sources,
+			     PathwayTab& p,
+			     map<string, size_t>& sampleMap,
+			     ObservationMatrix& observations,
+			     ThreadPool& pool)
+{
+  vector< pair< size_t, size_t > > chunks; // (source, chunk)
+  for (size_t i = 0; i < sources.size(); ++i) {
+    if (VERBOSE)
+      cerr << "Parsing evidence file: " << sources[i].evidenceFile() << endl;
+    size_t n = sources[i].stage(p, pool.size() * 4);
+    for (size_t k = 0; k < n; ++k) {
+      chunks.push_back(make_pair(i, k));
+    }
+  }
+
+  // report the error of the earliest chunk, whichever thread hit it first
+  vector< exception_ptr > errors(chunks.size());
+  pool.parallelFor(chunks.size(), [&](size_t t) {
+      try {
+	sources[chunks[t].first].parseChunk(chunks[t].second);
+      } catch (...) {
+	errors[t] = current_exception();
+      }
+    });
+  for (size_t t = 0; t < errors.size(); ++t) {
+    if (errors[t]) {
+      rethrow_exception(errors[t]);
+    }
+  }
+
+  for (size_t i = 0; i < sources.size(); ++i) {
+    sources[i].commit(p, sampleMap, observations);
+  }
+}
 
 void Tokenize(const string& str,
 	      vector<string>& tokens,
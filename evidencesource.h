@@ -9,11 +9,15 @@
 #ifndef HEADER_EVIDENCESOURCE_H
 #define HEADER_EVIDENCESOURCE_H
 
+#include <string_view>
 #include <vector>
 #include <dai/alldai.h>
 #include <dai/evidence.h>
 
+#include "discretizer.h"
+#include "observationmatrix.h"
 #include "pathwaytab.h"
+#include "threadpool.h"
 
 using namespace std;
 using namespace dai;
@@ -31,10 +35,33 @@ public:
 
 typedef map<string, map<string,int> > SampleEvidMap;
 
+class EvidenceMatrix;
+class TextContents;
+
+/// How one evidence file column is read: into the observation variable
+/// of a pathway gene, or skipped for genes outside the pathway
+struct EvidenceColumn {
+  string gene;
+  Var var;
+  size_t column; // in the ObservationMatrix
+  bool skip;
+};
+
+/// The rows of one chunk of an evidence file, held until the chunks are
+/// merged in file order
+struct EvidenceRows {
+  vector< string > samples;
+  vector< size_t > ends;    // end of each row in the cells below
+  vector< size_t > columns;
+  vector< float > values;
+  vector< unsigned char > states;
+};
+
 class EvidenceSource
 {
 private:
   vector<double> cutoffs;
+  Discretizer _discretizer;
   PropertySet options;
   string attachPoint;
   string _suffix;
@@ -46,56 +73,96 @@ private:
   vector<string> _sampleFactors;
   vector<int> _sampleFactorNum;
 
+  /// Built from the header; rows are only split up to the last column
+  /// that is not skipped
+  vector<EvidenceColumn> _columns;
+  size_t _usedColumns;
+
+  /// Staging buffers, filled by stage() and parseChunk() without
+  /// touching the pathway, and released by commit()
+  bool _staged;
+  shared_ptr< const TextContents > _text;
+  shared_ptr< const EvidenceMatrix > _matrix;
+  vector< const char* > _bounds; // chunk boundaries in _text
+  vector< EvidenceRows > _rows;  // one per chunk
+
+  /// Streaming state: the open text file or the matrix row to read next
+  shared_ptr< istream > _stream;
+  size_t _streamRow;
+  string _line;
+  EvidenceRows _streamed;
+
+  shared_ptr< const EvidenceMatrix > upToDateMatrix() const;
+
+  /// True when the evidence comes from standard input (input=-) or a
+  /// named pipe, which can only be read once and has no evidence matrix
+  bool piped() const;
+
+  void registerColumns(PathwayTab& p, ObservationMatrix& observations);
+  void planColumns(const PathwayTab& p, const vector< string_view >& genes);
+  void parseRows(const char* begin, const char* end, EvidenceRows& out) const;
+  void decodeMatrix(EvidenceRows& out) const;
+
 public:
   /// Default constructor
   EvidenceSource() : cutoffs(),
+		     _discretizer(),
 		     attachPoint(),
 		     _suffix(),
 		     _evidenceFile(),
 		     _disc(),
 		     _sampleNames(),
 		     _sampleFactors(),
-		     _sampleFactorNum()
+		     _sampleFactorNum(),
+		     _columns(),
+		     _usedColumns(0),
+		     _staged(false),
+		     _streamRow(0)
 
   {
     setCutoffs("-1.3;1.3");
   }
-  /// Copy constructor
-  EvidenceSource(const EvidenceSource &x)
-  : cutoffs(x.cutoffs),
-    attachPoint(x.attachPoint),
-    _suffix(x._suffix),
-    _evidenceFile(x._evidenceFile),
-    _disc(x._disc),
-    _sampleNames(x._sampleNames),
-    _sampleFactors(x._sampleFactors),
-    _sampleFactorNum(x._sampleFactorNum) {}
-
-  /// Assignment operator
-  EvidenceSource& operator=(const EvidenceSource &x) {
-    if (this != &x) {
-      cutoffs = x.cutoffs;
-      options = x.options;
-      attachPoint = x.attachPoint;
-      _suffix = x._suffix;
-      _evidenceFile = x._evidenceFile;
-      _disc = x._disc;
-      _sampleNames = x._sampleNames;
-      _sampleFactors = x._sampleFactors;
-      _sampleFactorNum = x._sampleFactorNum;
-    }
-    return *this;
-  }
+  /// Move-only, so the per-sample tables are never deep-copied
+  EvidenceSource(const EvidenceSource &x) = delete;
+  EvidenceSource& operator=(const EvidenceSource &x) = delete;
+  EvidenceSource(EvidenceSource &&x) = default;
+  EvidenceSource& operator=(EvidenceSource &&x) = default;
 
   /// Useful constructor
   EvidenceSource(PropertySet &p, string base);
 
   void setCutoffs(string discLimits);
-  int discCutoffs (float x);
-
-  void loadFromFile(PathwayTab& p,
-		    map<string, size_t>& sampleMap,
-		    vector<Evidence::Observation>& sampleData);
+  int discCutoffs (float x) const;
+
+  /// Maps the evidence file, or its .evb matrix when that is up to
+  /// date, reads the header and splits the rows into at most \a chunks
+  /// pieces; returns the number of pieces.  \a p is only read.
+  size_t stage(const PathwayTab& p, size_t chunks=1);
+  /// Parses piece \a k of the staged rows.  Pieces of any number of
+  /// sources may be parsed concurrently.
+  void parseChunk(size_t k);
+  /// Adds the observation nodes of the staged columns to \a p and the
+  /// parsed rows to \a observations, in file order
+  void commit(PathwayTab& p,
+	      map<string, size_t>& sampleMap,
+	      ObservationMatrix& observations);
+
+  /// Streaming alternative to stage() and commit(): reads only the
+  /// header and adds its observation nodes to \a p
+  void openStream(PathwayTab& p, ObservationMatrix& observations);
+  /// Reads the next row into \a row of \a observations, which should
+  /// be cleared first, and its sample name into \a sample; returns false
+  /// at the end of the file
+  bool nextRow(string& sample, ObservationMatrix& observations, size_t row);
+
+  /// Stages all of \a sources, parses them together on \a pool and
+  /// commits them in order, so node numbering does not depend on which
+  /// file finished first
+  static void loadAll(vector<EvidenceSource>& sources,
+		      PathwayTab& p,
+		      map<string, size_t>& sampleMap,
+		      ObservationMatrix& observations,
+		      ThreadPool& pool);
 
   const string& evidenceFile() {return _evidenceFile;}
   const vector<string>& sampleNames() {return _sampleNames;}
@@ -0,0 +1,68 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+#include "evidencematrix.h"
+#include "evidencesource.h"
+
+void usage(int exit_code) {
+  cout << "evidencetab2bin"
+#ifdef VERSION
+       << " -- " << VERSION
+#endif
+       << endl
+       << "Usage: " << endl
+       << "  evidencetab2bin [-d cutoffs] evidence_file..." << endl
+       << "Writes evidence_file" << EvidenceMatrix::EXTENSION
+       << ", which paradigm reads instead of the text file" << endl
+       << "while it is up to date.  With -d (as in the evidence disc"
+       << " option," << endl
+       << "e.g. -d '-1.3;1.3') the values are stored already discretized."
+       << endl;
+  exit(exit_code);
+}
+
+int main(int argc, char** argv) {
+  bool discretize = false;
+  vector< double > cutoffs;
+  int opt;
+  while ((opt = getopt(argc, argv, "hd:")) != -1) {
+    switch (opt) {
+    case 'd': {
+      discretize = true;
+      vector< string > cutoffsStr;
+      Tokenize(optarg, cutoffsStr, ";");
+      for (size_t i = 0; i < cutoffsStr.size(); i++) {
+	cutoffs.push_back(atof(cutoffsStr[i].c_str()));
+      }
+      break;
+    }
+    case 'h': usage(0); break;
+    default: usage(2);
+    }
+  }
+  if (optind == argc) {
+    usage(2);
+  }
+
+  for (int i = optind; i < argc; ++i) {
+    string tab = argv[i];
+    try {
+      EvidenceMatrix::convert(tab, tab + EvidenceMatrix::EXTENSION,
+			      discretize ? &cutoffs : NULL);
+    } catch (const std::exception& e) {
+      cerr << tab << ": " << e.what() << endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -9,4 +9,4 @@
 #include "common.h"
 
 // globals
-bool VERBOSE = false;
+std::atomic< bool > VERBOSE(false);
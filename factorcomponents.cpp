@@ -0,0 +1,101 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include "factorcomponents.h"
+
+const size_t FactorComponents::NONE = (size_t)-1;
+
+DisjointSets::DisjointSets(size_t n) : _parent(n), _rank(n, 0)
+{
+  for (size_t i = 0; i < n; ++i) {
+    _parent[i] = i;
+  }
+}
+
+size_t DisjointSets::find(size_t x)
+{
+  while (_parent[x] != x) {
+    _parent[x] = _parent[_parent[x]];
+    x = _parent[x];
+  }
+  return x;
+}
+
+void DisjointSets::join(size_t a, size_t b)
+{
+  a = find(a);
+  b = find(b);
+  if (a == b) {
+    return;
+  }
+  if (_rank[a] < _rank[b]) {
+    swap(a, b);
+  }
+  _parent[b] = a;
+  if (_rank[a] == _rank[b]) {
+    ++_rank[a];
+  }
+}
+
+FactorComponents::FactorComponents(const vector< Factor >& factors)
+  : _factors(), _varComponent(), _vars()
+{
+  size_t nlabels = 0;
+  for (size_t I = 0; I < factors.size(); ++I) {
+    const VarSet& vs = factors[I].vars();
+    for (VarSet::const_iterator v = vs.begin(); v != vs.end(); ++v) {
+      nlabels = max(nlabels, v->label() + 1);
+    }
+  }
+
+  DisjointSets sets(nlabels);
+  vector< Var > seen(nlabels);
+  vector< bool > used(nlabels, false);
+  for (size_t I = 0; I < factors.size(); ++I) {
+    const VarSet& vs = factors[I].vars();
+    for (VarSet::const_iterator v = vs.begin(); v != vs.end(); ++v) {
+      sets.join(vs.begin()->label(), v->label());
+      seen[v->label()] = *v;
+      used[v->label()] = true;
+    }
+  }
+
+  vector< size_t > rootComponent(nlabels, NONE);
+  for (size_t I = 0; I < factors.size(); ++I) {
+    if (factors[I].vars().size() == 0) {
+      continue;
+    }
+    size_t root = sets.find(factors[I].vars().begin()->label());
+    if (rootComponent[root] == NONE) {
+      rootComponent[root] = _factors.size();
+      _factors.push_back(vector< size_t >());
+    }
+    _factors[rootComponent[root]].push_back(I);
+  }
+
+  _varComponent.assign(nlabels, NONE);
+  for (size_t label = 0; label < nlabels; ++label) {
+    if (used[label]) {
+      _varComponent[label] = rootComponent[sets.find(label)];
+      _vars.push_back(seen[label]);
+    }
+  }
+}
+
+vector< Factor >
+FactorComponents::linkingFactors(const vector< Factor >& factors) const
+{
+  vector< Factor > links;
+  for (size_t c = 1; c < _factors.size(); ++c) {
+    VarSet I_vars;
+    I_vars |= *factors[_factors[c - 1][0]].vars().begin();
+    I_vars |= *factors[_factors[c][0]].vars().begin();
+    links.push_back(Factor(I_vars, 1.0));
+  }
+  return links;
+}
@@ -0,0 +1,68 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_FACTORCOMPONENTS_H
+#define HEADER_FACTORCOMPONENTS_H
+
+#include <vector>
+#include <dai/factor.h>
+
+using namespace std;
+using namespace dai;
+
+/// Union-find over the integers [0, n)
+class DisjointSets
+{
+private:
+  vector< size_t > _parent;
+  vector< unsigned char > _rank;
+
+public:
+  DisjointSets(size_t n);
+
+  size_t find(size_t x);
+  void join(size_t a, size_t b);
+};
+
+/// The connected components of a factor list, where two factors are
+/// connected when they share a variable.  Components are numbered in the
+/// order of their first factor.
+class FactorComponents
+{
+public:
+  static const size_t NONE;
+
+private:
+  vector< vector< size_t > > _factors;
+  vector< size_t > _varComponent; // by variable label
+  vector< Var > _vars;             // sorted by label
+
+public:
+  FactorComponents(const vector< Factor >& factors);
+
+  size_t size() const { return _factors.size(); }
+
+  /// Indices into the original factor list, in their original order
+  const vector< size_t >& factors(size_t component) const {
+    return _factors[component];
+  }
+
+  /// The component holding the variable \a label, or NONE
+  size_t component(size_t label) const {
+    return label < _varComponent.size() ? _varComponent[label] : NONE;
+  }
+
+  /// Every variable of the factor list, in FactorGraph order
+  const vector< Var >& vars() const { return _vars; }
+
+  /// Uniform factors that join all components into a single connected
+  /// graph without changing its distribution
+  vector< Factor > linkingFactors(const vector< Factor >& factors) const;
+};
+
+#endif
@@ -0,0 +1,116 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "mappedfile.h"
+#include "perturbationmatrix.h"
+#include "perturbationwriter.h"
+#include "tabtokenizer.h"
+
+void usage(int exit_code) {
+  cout << "lookupsample"
+#ifdef VERSION
+       << " -- " << VERSION
+#endif
+       << endl
+       << "Usage: " << endl
+       << "  lookupsample output_file sample..." << endl
+       << "Prints the scores of each sample from a paradigm output written"
+       << " with -i," << endl
+       << "using output_file" << PerturbationWriter::INDEX_EXTENSION
+       << " to go straight to them; binary outputs are printed" << endl
+       << "in the fasta format." << endl;
+  exit(exit_code);
+}
+
+int main(int argc, char** argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "h")) != -1) {
+    switch (opt) {
+    case 'h': usage(0); break;
+    default: usage(2);
+    }
+  }
+  if (argc - optind < 2) {
+    usage(2);
+  }
+  string output = argv[optind];
+  string indexFile = output + PerturbationWriter::INDEX_EXTENSION;
+
+  int status = 0;
+  try {
+    MappedFile index(indexFile);
+    unordered_multimap< string_view,
+			pair< unsigned long long, size_t > > blocks;
+    TabTokenizer lines(index.data(), index.data() + index.size());
+    vector< string_view > fields;
+    while (lines.next(fields)) {
+      if (fields.size() != 3) {
+	cerr << indexFile << ": not a sample index" << endl;
+	return 1;
+      }
+      blocks.emplace(fields[0],
+		     make_pair(strtoull(string(fields[1]).c_str(), NULL, 10),
+			       strtoul(string(fields[2]).c_str(), NULL, 10)));
+    }
+
+    unique_ptr< MappedFile > text;
+    unique_ptr< PerturbationMatrix > matrix;
+    unique_ptr< FastaPerturbationWriter > fasta;
+    if (!PerturbationMatrix::isMatrix(output)) {
+      text.reset(new MappedFile(output, MappedFile::RANDOM));
+    } else {
+      matrix.reset(new PerturbationMatrix(output));
+      fasta.reset(new FastaPerturbationWriter(cout));
+      vector< string > nodes;
+      for (size_t c = 0; c < matrix->nodes(); ++c) {
+	nodes.push_back(string(matrix->node(c)));
+      }
+      fasta->begin(nodes);
+    }
+
+    vector< double > scores;
+    for (int i = optind + 1; i < argc; ++i) {
+      auto found = blocks.equal_range(argv[i]);
+      if (found.first == found.second) {
+	cerr << "!! No sample " << argv[i] << " in " << indexFile << endl;
+	status = 1;
+      }
+      for (auto b = found.first; b != found.second; ++b) {
+	unsigned long long offset = b->second.first;
+	size_t length = b->second.second;
+	if (text) {
+	  if (offset > text->size() || length > text->size() - offset) {
+	    cerr << indexFile << " does not match " << output << endl;
+	    return 1;
+	  }
+	  cout.write(text->data() + offset, length);
+	  continue;
+	}
+	size_t r = matrix->rowAt(offset);
+	if (r == matrix->samples() || matrix->sample(r) != argv[i]) {
+	  cerr << indexFile << " does not match " << output << endl;
+	  return 1;
+	}
+	const float* row = matrix->row(r);
+	scores.assign(row, row + matrix->nodes());
+	fasta->write(argv[i], matrix->loglikelihood(r), scores);
+      }
+    }
+    cout.flush();
+  } catch (const std::exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return status;
+}
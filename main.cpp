@@ -7,8 +7,12 @@
 /********************************************************************************/
 
 #include <getopt.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <sstream>
 #include <map>
 #include <dai/alldai.h>
@@ -17,8 +21,15 @@
 #include <sys/resource.h>
 
 #include "common.h"
+#include "compressedio.h"
 #include "configuration.h"
+#include "emparameters.h"
 #include "evidencesource.h"
+#include "factorcomponents.h"
+#include "pathwaycache.h"
+#include "perturbationoutput.h"
+#include "textbuffer.h"
+#include "threadpool.h"
 
 using namespace std;
 using namespace dai;
@@ -41,8 +52,45 @@ void print_usage(int signal)
        << "C++ program for taking bioInt data and performing inference using libdai" << endl
        << "Note this can't be linked in to kent src as libDAI is GPL" << endl
        << "Valid options:" << endl
-       << "\t-e emOutputFile" << endl
+       << "\t-a,--summary file : Per-sample loglikelihood, mean |score| and count"
+       << endl
+       << "\t                  of scores above output [threshold=x]; with"
+       << endl
+       << "\t                  output [format=none] nothing else is written"
+       << endl
+       << "\t-e emOutputFile : Learned parameters; a name ending in "
+       << EmParameterFile::EXTENSION << " writes them" << endl
+       << "\t                  in binary after every EM iteration" << endl
+       << "\t-o outputFile   : Perturbation scores; output [format=binary] in the"
+       << endl
+       << "\t                  configuration writes a binary matrix instead;"
+       << endl
+       << "\t                  output [format=sparse,threshold=x,top_k=n] only"
+       << endl
+       << "\t                  the nodes whose |score| exceeds x, at most n each"
+       << endl
+       << "\t                  (-e and -o files ending in .gz or .zst are compressed;"
+       << endl
+       << "\t                  evidence and pathway files may be compressed too)"
+       << endl
+       << "\t-i,--index      : Also write outputFile" << PerturbationWriter::INDEX_EXTENSION
+       << ", the offset and length of each" << endl
+       << "\t                  sample's scores, for lookupsample" << endl
+       << "\t-l,--load-em file : Start from the parameters in a "
+       << EmParameterFile::EXTENSION << " file of an earlier run" << endl
        << "\t-m max_mem      : The maximum number of GB that can be allocated" << endl
+       << "\t-s,--stream     : Infer each sample as soon as its evidence rows are"
+       << endl
+       << "\t                  read, in file order; needs em [max_iters=0]" << endl
+       << "\t                  (evidence [input=-] reads standard input instead"
+       << endl
+       << "\t                  of prefix+suffix, and input=file any file or named"
+       << endl
+       << "\t                  pipe, so evidence can be piped in as it is made)"
+       << endl
+       << "\t-t,--threads n  : Run inference on n threads" << endl
+       << "\t-w,--write-cache : Compile the pathway to path.tab"
+       << PathwayCache::EXTENSION << " for later runs" << endl
        << "\t-v,--verbose    : verbose mode" << endl;
   exit(signal);
 }
@@ -53,108 +101,98 @@ void die(string msg)
   exit(-1);
 }
 
-inline double log10odds(double post,double prior)
+/// The marginals of each output variable: the down, nc and up
+/// probabilities of variable i at out[3 * i] onwards.  Given the prior
+/// algorithms and their marginals, variables whose component was not
+/// clamped copy the prior instead of asking the algorithm again.
+void gatherMarginals(const vector< InfAlg* >& algs,
+		     const FactorComponents& components,
+		     const vector< size_t >& outputVars,
+		     vector< double >& out,
+		     const vector< InfAlg* >* priorAlgs = NULL,
+		     const vector< double >* priorMarginals = NULL)
 {
-  return std::log( ( post / (1.0 - post) )
-		   / ( prior / (1.0 - prior) ) )
-    / log(10);
+  out.resize(3 * outputVars.size());
+  for (size_t i = 0; i < outputVars.size(); ++i)
+    {
+      const Var& v = components.vars()[outputVars[i]];
+      size_t c = components.component(v.label());
+      if (priorAlgs != NULL && algs[c] == (*priorAlgs)[c])
+	{
+	  copy(&(*priorMarginals)[3 * i], &(*priorMarginals)[3 * i] + 3,
+	       &out[3 * i]);
+	  continue;
+	}
+      Factor belief = algs[c]->belief(v);
+      for (size_t j = 0; j < 3; ++j)
+	out[3 * i + j] = belief[j];
+    }
 }
 
-// returns a map of all the nodes in a single subnet, for testing against
-map< long, bool > nodesInSingleNet(vector< Factor > factors)
+/// Scores \a n variables from their dense posterior and prior marginals
+/// (see gatherMarginals) without allocating.  The state with the largest
+/// odds ratio wins and its log10 odds ratio is the score, negated for
+/// down and 0 for nc; log10 is monotone, so the ratios are compared
+/// directly and only the winner pays for a log.  The loop stays scalar,
+/// as the call to std::log keeps it from being vectorized.  A score is
+/// NaN, written as NA, where a marginal is exactly 1 or where the
+/// winning state's posterior and prior are both 0; the per-node code
+/// this replaced printed "nan" for that 0/0 ratio.  Comparing the ratios
+/// rather than their rounded logs can also pick a different state when
+/// two ratios differ by less than the rounding of log.
+void scoreLogOdds(const double* posteriors, const double* priors, size_t n,
+		  double* scores)
 {
-  // start with a single (random) node, and follow it out, marking down all the nodes we see
-  map< long, bool > nodesSeen;
-  vector< long > nodesToCheck;
-  vector< Factor >::iterator factorIter = factors.begin();
-  const VarSet tmpVars = factorIter->vars();
-  vector< Var >::const_iterator tmpVarsIter;
-  for (tmpVarsIter = tmpVars.begin(); tmpVarsIter != tmpVars.end(); ++tmpVarsIter) {
-	const long varLabel = tmpVarsIter->label();
-	nodesToCheck.push_back(varLabel);
-	nodesSeen[varLabel] = true;
-  }
-  while(nodesToCheck.size() > 0)
-  {
-	long currNode = nodesToCheck.back();
-	nodesToCheck.pop_back();
-	for ( factorIter = factors.begin(); factorIter != factors.end(); ++factorIter) {
-	  const VarSet tmpVars = factorIter->vars();
-	  //vector< Var >::const_iterator tmpVarsIter = tmpVars.begin();
-	  for (tmpVarsIter = tmpVars.begin(); tmpVarsIter != tmpVars.end(); ++tmpVarsIter) {
-		const long varLabel = tmpVarsIter->label();
-		if(varLabel == currNode)
-		{
-		  vector< Var >::const_iterator tmpVarsIter2 = tmpVars.begin();
-		  for ( ; tmpVarsIter2 != tmpVars.end(); ++tmpVarsIter2) {
-			const long varLabel2 = tmpVarsIter2->label();
-			if(!nodesSeen[varLabel2])
-			{
-			  nodesToCheck.push_back(varLabel2);
-			  nodesSeen[varLabel2] = true;
-			}
-		  }
-		}
-	  }
-	}
-
-  }
-  return nodesSeen;
+  const double NA = numeric_limits<double>::quiet_NaN();
+  const double LOG10 = std::log(10.0);
+  for (size_t i = 0; i < n; ++i)
+    {
+      const double* post = posteriors + 3 * i;
+      const double* prior = priors + 3 * i;
+      bool na = (post[0] == 1) | (post[1] == 1) | (post[2] == 1)
+	| (prior[0] == 1) | (prior[1] == 1) | (prior[2] == 1);
+      double down = (post[0] / (1.0 - post[0])) / (prior[0] / (1.0 - prior[0]));
+      double nc = (post[1] / (1.0 - post[1])) / (prior[1] / (1.0 - prior[1]));
+      double up = (post[2] / (1.0 - post[2])) / (prior[2] / (1.0 - prior[2]));
+
+      bool unchanged = (nc > down) & (nc > up);
+      bool isDown = !unchanged & (down > up);
+      double score = std::log(unchanged ? 1.0 : isDown ? down : up) / LOG10;
+      scores[i] = na ? NA : isDown ? -1.0 * score : score;
+    }
 }
 
-void outputFastaPerturbations(string sampleName, InfAlg* prior, InfAlg* sample,
-			      FactorGraph& fg, map<long,string>& activeNodes,
-			      ostream& out)
+/// The perturbation score of each output variable of a sample, NaN
+/// where it is NA; returns the loglikelihood of the sample.
+/// \a priorMarginals holds the marginals of \a priorAlgs, which do not
+/// change between samples, and \a posteriors is scratch space.
+double perturbationScores(const vector< InfAlg* >& priorAlgs,
+			  const vector< double >& priorMarginals,
+			  const vector< InfAlg* >& sampleAlgs,
+			  const FactorComponents& components,
+			  const vector< size_t >& outputVars,
+			  vector< double >& posteriors,
+			  vector< double >& scores)
 {
-  out << "> " << sampleName;
-  out << " loglikelihood=" << (sample->logZ() - prior->logZ())
-       << endl;
-  for (size_t i = 0; i < fg.nrVars(); ++i)
+  double loglikelihood = 0;
+  for (size_t c = 0; c < sampleAlgs.size(); ++c)
     {
-      const Var& v = fg.var(i);
-      if(activeNodes.count(v.label()) == 0)
-	continue;
-      out << activeNodes[v.label()];
-      Factor priorBelief = prior->belief(v);
-      Factor belief = sample->belief(v);
-      vector<double> priors;
-      vector<double> posteriors;
-      bool beliefEqualOne = false;
-
-      for (size_t j = 0; j < belief.nrStates(); ++j)
-	{
-	  if(belief[j] == 1 || priorBelief[j] == 1)
-	    {
-	      beliefEqualOne = true;
-	      break;
-	    }
-	  priors.push_back(priorBelief[j]);
-	  posteriors.push_back(belief[j]);
-	}
-      out << "\t";
-      if(beliefEqualOne)
-	out << "NA";
-      else
-	{
-	  double down = log10odds(posteriors[0],priors[0]);
-	  double nc = log10odds(posteriors[1],priors[1]);
-	  double up = log10odds(posteriors[2],priors[2]);
-
-	  if (nc > down && nc > up)
-	    out << "0";
-	  else if (down > up)
-	    out << (-1.0*down);
-	  else
-	    out << up;
-	}
-      out << endl;
+      if (sampleAlgs[c] != priorAlgs[c])
+	loglikelihood += sampleAlgs[c]->logZ() - priorAlgs[c]->logZ();
     }
+  gatherMarginals(sampleAlgs, components, outputVars, posteriors,
+		  &priorAlgs, &priorMarginals);
+  scores.resize(outputVars.size());
+  scoreLogOdds(posteriors.data(), priorMarginals.data(), outputVars.size(),
+	       scores.data());
+  return loglikelihood;
 }
 
 void outputEmInferredParams(ostream& out, EMAlg& em, PathwayTab& pathway,
 			    const vector< vector < SharedParameters::FactorOrientations > > &var_orders) {
-  out << "> em_iters=" << em.Iterations()
-      << " logZ=" << em.logZ() << endl;
+  TextBuffer text;
+  text << "> em_iters=" << em.Iterations()
+       << " logZ=" << em.logZ() << '\n';
   size_t i = 0;
   for (EMAlg::s_iterator m = em.s_begin(); m != em.s_end(); ++m, ++i) {
     size_t j = 0;
@@ -171,23 +209,36 @@ void outputEmInferredParams(ostream& out, EMAlg& em, PathwayTab& pathway,
       for (size_t vi = 0; vi < vars.size(); ++vi) {
 	dims.push_back(vars[vi].states());
 	if (vi == 0) {
-	  out << "> child='"<< pathway.getNode(vars[vi].label()).second << "'";
+	  text << "> child='"<< pathway.getNode(vars[vi].label()).second << '\'';
 	} else {
-	  out << " edge" << vi << "='"
-	      << pathway.getInteraction(vars[0].label(), vars[vi].label())
-	      << '\'';
+	  text << " edge" << vi << "='"
+	       << pathway.getInteraction(vars[0].label(), vars[vi].label())
+	       << '\'';
 	}
       }
       // Output actual parameters
-      out << endl;
+      text << '\n';
       for(multifor s(dims); s.valid(); ++s) {
 	for (size_t state = 0; state < dims.size(); ++state) {
-	  out << s[state] << '\t';
+	  text << s[state] << '\t';
 	}
-	out << f[perm.convertLinearIndex((size_t)s)] << endl;
+	text << f[perm.convertLinearIndex((size_t)s)] << '\n';
       }
+      text.writeTo(out);
     }
   }
+  text.writeTo(out);
+}
+
+void outputEmBinaryParams(const string& filename, EMAlg& em,
+			  PathwayTab& pathway,
+			  const vector< vector < SharedParameters::FactorOrientations > > &var_orders) {
+  try {
+    writeEmParameters(filename, em.Iterations(), em.logZ(),
+		      parameterTables(em.eStep().fg(), pathway, var_orders));
+  } catch (const runtime_error& e) {
+    die(e.what());
+  }
 }
 
 void setMaxMem(unsigned long maxmem) {
@@ -208,16 +259,22 @@ void setMaxMemGigs(char * maxmem) {
 
 int main(int argc, char *argv[])
 {
-  const char* const short_options = "hp:b:c:e:m:o:v";
+  const char* const short_options = "hp:a:b:c:e:il:m:o:st:vw";
   const struct option long_options[] = {
+    { "summary", 1, NULL, 'a' },
     { "batch", 0, NULL, 'b' },
     { "config", 0, NULL, 'c' },
     { "pathway", 0, NULL, 'p' },
     { "em", 0, NULL, 'e' },
+    { "index", 0, NULL, 'i' },
+    { "load-em", 1, NULL, 'l' },
     { "maxmem", 0, NULL, 'm' },
     { "output", 0, NULL, 'o' },
+    { "stream", 0, NULL, 's' },
+    { "threads", 1, NULL, 't' },
     { "help", 0, NULL, 'h' },
     { "verbose", 0, NULL, 'v' },
+    { "write-cache", 0, NULL, 'w' },
     { NULL, 0, NULL, 0 }
   };
   int next_options;
@@ -226,7 +283,13 @@ int main(int argc, char *argv[])
   string batchPrefix;
   string configFile;
   string paramsOutputFile;
+  string paramsInputFile;
   string actOutFile;
+  string summaryFile;
+  size_t threads = 1;
+  bool writeCache = false;
+  bool streaming = false;
+  bool writeIndex = false;
 
   // /////////////////////////////////////////////////
   // Read in command line options
@@ -235,28 +298,22 @@ int main(int argc, char *argv[])
     next_options=getopt_long(argc,argv,short_options,long_options,NULL);
     switch (next_options){
     case 'h': print_usage(EXIT_SUCCESS); break;
+    case 'a': summaryFile = optarg; break;
     case 'b': batchPrefix = optarg; break;
     case 'c': configFile = optarg; break;
     case 'p': pathwayFilename = optarg; break;
     case 'e': paramsOutputFile = optarg; break;
+    case 'i': writeIndex = true; break;
+    case 'l': paramsInputFile = optarg; break;
     case 'm': setMaxMemGigs(optarg); break;
     case 'o': actOutFile = optarg; break;
+    case 's': streaming = true; break;
+    case 't': threads = strtoul(optarg, NULL, 10); break;
 	case 'v': VERBOSE = true; break;
+    case 'w': writeCache = true; break;
     }
   } while (next_options != -1);
 
-  ostream* outstream;
-  ofstream outFileStream;
-  if (actOutFile == "") {
-    outstream = &cout;
-  } else {
-    outFileStream.open(actOutFile.c_str());
-    if (!outFileStream.is_open()) {
-      die("couldn't open output file");
-    }
-    outstream = &outFileStream;
-  }
-
   // /////////////////////////////////////////////////
   // Verify that command line options are valid
   //
@@ -282,123 +339,260 @@ int main(int argc, char *argv[])
   if (conf.evidenceSize() == 0) {
     die("Must have at least one evidence file in configuration.");
   }
+  if (streaming && (conf.emMaxIters() > 0 || paramsOutputFile != "")) {
+    die("Streaming needs em [max_iters=0] and no -e, as EM sees every sample");
+  }
+
+  unique_ptr<PerturbationWriter> writer;
+  try {
+    writer = newPerturbationWriter(conf.outputProps(), actOutFile,
+				   writeIndex);
+    if (summaryFile != "") {
+      vector< unique_ptr< PerturbationWriter > > writers;
+      writers.push_back(std::move(writer));
+      writers.push_back(newSummaryWriter(conf.outputProps(), summaryFile));
+      writer.reset(new TeePerturbationWriter(std::move(writers)));
+    }
+  } catch (const runtime_error& e) {
+    die(e.what());
+  }
 
   // /////////////////////////////////////////////////
-  // Load pathway
-  ifstream pathwayStream;
-  pathwayStream.open(pathwayFilename.c_str());
-  if (!pathwayStream.is_open()) {
+  // Load pathway, from its compiled cache when that is up to date
+  if (!MappedFile::exists(pathwayFilename)) {
     die("Could not open pathway stream");
   }
-  PathwayTab pathway = PathwayTab::create(pathwayStream, conf.pathwayProps());
+  PathwayTab pathway = PathwayCache::load(pathwayFilename, conf.pathwayProps(),
+					  writeCache);
+
+  ThreadPool pool(threads);
 
   // /////////////////////////////////////////////////
-  // Read in evidence
+  // Read in evidence; when streaming only the headers are read here, and
+  // a single observation row is reused for every sample
   vector<EvidenceSource> evid;
   map<string,size_t> sampleMap;
-  vector<Evidence::Observation> sampleData;
+  ObservationMatrix observations;
+  size_t fromStdin = 0;
   for(size_t i = 0; i < conf.evidenceSize(); i++) {
-    EvidenceSource e(conf.evidence(i), batchPrefix);
+    evid.emplace_back(conf.evidence(i), batchPrefix);
+    if (evid.back().evidenceFile() == "-")
+      fromStdin++;
+  }
+  if (fromStdin > 1)
+    die("Only one evidence source can read standard input");
+  if (streaming) {
+    for(size_t i = 0; i < evid.size(); i++) {
+      if(VERBOSE)
+	cerr << "Streaming evidence file: " << evid[i].evidenceFile() << endl;
+      evid[i].openStream(pathway, observations);
+    }
+    observations.addRow();
+  } else {
+    EvidenceSource::loadAll(evid, pathway, sampleMap, observations, pool);
+    for(size_t i = 1; i < evid.size(); i++) {
+      if (evid[i].sampleNames() != evid[0].sampleNames())
+	{
+	  die("Sample names differ in files " + evid[i].evidenceFile() + " and "
+	      + evid[0].evidenceFile());
+	}
+    }
     if(VERBOSE)
-      cerr << "Parsing evidence file: " << e.evidenceFile() << endl;
-    e.loadFromFile(pathway, sampleMap, sampleData);
-    evid.push_back(e);
-    if (i > 0 && e.sampleNames() != evid[0].sampleNames())
-      {
-	die("Sample names differ in files " + e.evidenceFile() + " and "
-	    + evid[0].evidenceFile());
-      }
+      cerr << "Added evidence for " << evid[0].sampleNames().size()
+	   << " samples" << endl;
   }
-  if(VERBOSE)
-    cerr << "Added evidence for " << evid[0].sampleNames().size()
-	 << " samples" << endl;
 
   // /////////////////////////////////////////////////
   // Construct the factor graph
+  pathway.freeze();
   vector< Factor > factors;
   vector< MaximizationStep > msteps;
   vector< vector < SharedParameters::FactorOrientations > > var_orders;
   var_orders = pathway.constructFactors(conf.emSteps(), factors, msteps);
   map< long, string > outNodes = pathway.getOutputNodeMap();
-
-  // add in additional factors to link disconnected pieces of the pathway
-  FactorGraph *testGraphConnected = new FactorGraph(factors);
-  while(!testGraphConnected->isConnected())
-  {
-    map< long, bool > nodesInSubNet = nodesInSingleNet(factors);
-    long backNode = nodesInSubNet.rbegin()->first;
-    VarSet I_vars;
-    I_vars |= Var(backNode, PathwayTab::VARIABLE_DIMENSION);
-    bool addedLink = false;
-    // now go find ones that aren't connected to this
-    vector< Factor >::iterator factorIter;
-    for ( factorIter = factors.begin(); !addedLink && factorIter != factors.end(); ++factorIter) {
-      const VarSet tmpVars = factorIter->vars();
-      vector< Var >::const_iterator tmpVarsIter;
-      for (tmpVarsIter = tmpVars.begin(); !addedLink && tmpVarsIter != tmpVars.end(); ++tmpVarsIter) {
-	const long varLabel = tmpVarsIter->label();
-	if(!nodesInSubNet[varLabel])
-	  {
-	    I_vars |= Var(varLabel, PathwayTab::VARIABLE_DIMENSION);
-
-	    factors.push_back( Factor( I_vars, 1.0 ) );
-	    addedLink = true;
-	  }
-      }
+  if (paramsInputFile != "") {
+    try {
+      EmParameterFile params(paramsInputFile);
+      applyEmParameters(params, pathway, var_orders, factors);
+    } catch (const runtime_error& e) {
+      die(e.what());
     }
-    break;
-    delete testGraphConnected;
-    testGraphConnected = new FactorGraph(factors);
+    if (VERBOSE)
+      cerr << "Loaded EM parameters from " << paramsInputFile << endl;
   }
-  delete testGraphConnected;
 
-  FactorGraph priorFG(factors);
+
+  // /////////////////////////////////////////////////
+  // Split the factor graph into connected components
+  FactorComponents components(factors);
+  if(VERBOSE)
+    cerr << "Factor graph has " << components.size()
+	 << " connected components" << endl;
 
   PropertySet inferenceOptions = conf.getInferenceProperties(pathwayFilename);
   std::string method = inferenceOptions.getAs<std::string>("method");
 
-  InfAlg* prior = newInfAlg(method, priorFG, inferenceOptions);
-  prior->init();
-
   // /////////////////////////////////////////////////
   // Run EM
-  const PropertySet& em_conf = conf.emProps();
-  Evidence evidence(sampleData);
-  EMAlg em(evidence, *prior, msteps, em_conf);
-  while(!em.hasSatisfiedTermConditions()) {
-    em.iterate();
-    if (VERBOSE) {
-      outputEmInferredParams(cerr, em, pathway, var_orders);
+  // Parameters are shared across components, so EM runs on a single graph
+  // with the components joined by uniform factors, which leave the
+  // distribution unchanged.
+  if (conf.emMaxIters() > 0 || paramsOutputFile != "") {
+    vector< Factor > linked(factors);
+    vector< Factor > links = components.linkingFactors(factors);
+    linked.insert(linked.end(), links.begin(), links.end());
+    FactorGraph linkedFG(linked);
+    InfAlg* estep = newInfAlg(method, linkedFG, inferenceOptions);
+    estep->init();
+    {
+      const PropertySet& em_conf = conf.emProps();
+      Evidence evidence = observations.toEvidence();
+      EMAlg em(evidence, *estep, msteps, em_conf);
+      // binary parameters are cheap enough to checkpoint every iteration
+      bool binaryParams = endsWith(paramsOutputFile, EmParameterFile::EXTENSION);
+      while(!em.hasSatisfiedTermConditions()) {
+	em.iterate();
+	if (VERBOSE) {
+	  outputEmInferredParams(cerr, em, pathway, var_orders);
+	}
+	if (binaryParams) {
+	  outputEmBinaryParams(paramsOutputFile, em, pathway, var_orders);
+	}
+      }
+      em.run();
+
+      if (binaryParams) {
+	outputEmBinaryParams(paramsOutputFile, em, pathway, var_orders);
+      } else if (paramsOutputFile != "") {
+	unique_ptr<ostream> paramsOutputStream = openOutput(paramsOutputFile);
+	if (*paramsOutputStream) {
+	  outputEmInferredParams(*paramsOutputStream, em, pathway, var_orders);
+	}
+      }
+      for (size_t I = 0; I < factors.size(); ++I) {
+	factors[I] = em.eStep().fg().factor(I);
+      }
     }
+    delete estep;
   }
-  em.run();
 
-  ofstream paramsOutputStream;
-  paramsOutputStream.open(paramsOutputFile.c_str());
-  if (paramsOutputStream.is_open()) {
-    outputEmInferredParams(paramsOutputStream, em, pathway, var_orders);
-  }
-  prior->run();
+  // /////////////////////////////////////////////////
+  // Run inference without evidence, once per component
+  vector< InfAlg* > priors(components.size());
+  pool.parallelFor(components.size(), [&](size_t c) {
+      vector< Factor > componentFactors;
+      componentFactors.reserve(components.factors(c).size());
+      for (size_t k = 0; k < components.factors(c).size(); ++k) {
+	componentFactors.push_back(factors[components.factors(c)[k]]);
+      }
+      FactorGraph componentFG(componentFactors);
+      priors[c] = newInfAlg(method, componentFG, inferenceOptions);
+      priors[c]->init();
+      priors[c]->run();
+    });
 
   // /////////////////////////////////////////////////
-  // Run inference on each of the samples
-  map<string, size_t>::iterator sample_iter = sampleMap.begin();
-  for ( ; sample_iter != sampleMap.end(); ++sample_iter) {
-    InfAlg* clamped = prior->clone();
-    Evidence::Observation *e = &sampleData[sample_iter->second];
-    for (Evidence::Observation::const_iterator i = e->begin(); i != e->end(); ++i) {
-      clamped->clamp( clamped->fg().findVar(i->first), i->second);
+  // Run inference on each of the samples; components without any
+  // evidence for a sample reuse their prior
+  vector< size_t > outputVars;
+  vector< string > outputNames;
+  for (size_t i = 0; i < components.vars().size(); ++i) {
+    map< long, string >::const_iterator n =
+      outNodes.find(components.vars()[i].label());
+    if (n != outNodes.end()) {
+      outputVars.push_back(i);
+      outputNames.push_back(n->second);
+    }
+  }
+  writer->begin(outputNames);
+  vector< double > priorMarginals;
+  gatherMarginals(priors, components, outputVars, priorMarginals);
+
+  vector< vector< pair< Var, size_t > > > clamps(components.size());
+  vector< pair< Var, size_t > > observed;
+  vector< double > posteriors;
+  vector< double > scores;
+  function< void(const string&, size_t) > inferSample =
+    [&](const string& sample_name, size_t row) {
+    for (size_t c = 0; c < clamps.size(); ++c) {
+      clamps[c].clear();
+    }
+    observations.observed(row, observed);
+    for (size_t k = 0; k < observed.size(); ++k) {
+      size_t c = components.component(observed[k].first.label());
+      if (c != FactorComponents::NONE) {
+	clamps[c].push_back(observed[k]);
+      }
     }
-    clamped->init();
-    clamped->run();
 
-    outputFastaPerturbations(sample_iter->first, prior, clamped, priorFG,
-			     outNodes, *outstream);
+    vector< InfAlg* > clamped(priors);
+    pool.parallelFor(components.size(), [&](size_t c) {
+	if (clamps[c].empty()) {
+	  return;
+	}
+	InfAlg* sample = priors[c]->clone();
+	for (size_t k = 0; k < clamps[c].size(); ++k) {
+	  sample->clamp(sample->fg().findVar(clamps[c][k].first),
+			clamps[c][k].second);
+	}
+	sample->init();
+	sample->run();
+	clamped[c] = sample;
+      });
+
+    double loglikelihood = perturbationScores(priors, priorMarginals, clamped,
+					      components, outputVars,
+					      posteriors, scores);
+    writer->write(sample_name, loglikelihood, scores);
+
+    for (size_t c = 0; c < clamped.size(); ++c) {
+      if (clamped[c] != priors[c]) {
+	delete clamped[c];
+      }
+    }
+  };
 
-    delete clamped;
+  if (streaming) {
+    // the files are read in lockstep, so each must list the samples in
+    // the same order; samples without any observation are skipped, as
+    // they are when loading everything
+    string sample_name;
+    string other_name;
+    size_t samples = 0;
+    for (;;) {
+      observations.clearRow(0);
+      bool more = evid[0].nextRow(sample_name, observations, 0);
+      for (size_t i = 1; i < evid.size(); ++i) {
+	if (evid[i].nextRow(other_name, observations, 0) != more
+	    || (more && other_name != sample_name)) {
+	  die("Sample names differ in files " + evid[i].evidenceFile()
+	      + " and " + evid[0].evidenceFile());
+	}
+      }
+      if (!more) {
+	break;
+      }
+      observations.observed(0, observed);
+      if (!observed.empty()) {
+	inferSample(sample_name, 0);
+	writer->flush();
+	++samples;
+      }
+    }
+    if(VERBOSE)
+      cerr << "Streamed evidence for " << samples << " samples" << endl;
+  } else {
+    map<string, size_t>::iterator sample_iter = sampleMap.begin();
+    for ( ; sample_iter != sampleMap.end(); ++sample_iter) {
+      inferSample(sample_iter->first, sample_iter->second);
+    }
   }
 
-  delete prior;
+  writer->finish();
+
+  for (size_t c = 0; c < priors.size(); ++c) {
+    delete priors[c];
+  }
 
   return 0;
 }
@@ -0,0 +1,77 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+MappedFile::MappedFile(const std::string& filename, Access access)
+  : _filename(filename), _data(NULL), _size(0)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    THROW("Could not open " + filename);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    THROW("Could not stat " + filename);
+  }
+  _size = st.st_size;
+  if (_size > 0) {
+    void* p = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      THROW("Could not map " + filename);
+    }
+    madvise(p, _size, access == RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+    _data = static_cast< const char* >(p);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (_data != NULL) {
+    munmap(const_cast< char* >(_data), _size);
+  }
+}
+
+bool MappedFile::exists(const std::string& filename)
+{
+  return access(filename.c_str(), R_OK) == 0;
+}
+
+bool MappedFile::isRegular(const std::string& filename)
+{
+  struct stat s;
+  return stat(filename.c_str(), &s) == 0 && S_ISREG(s.st_mode);
+}
+
+bool MappedFile::upToDate(const std::string& filename, const std::string& other)
+{
+  struct stat a, b;
+  if (stat(filename.c_str(), &a) != 0) {
+    return false;
+  }
+  if (stat(other.c_str(), &b) != 0) {
+    return true;
+  }
+  if (a.st_mtim.tv_sec != b.st_mtim.tv_sec) {
+    return a.st_mtim.tv_sec > b.st_mtim.tv_sec;
+  }
+  // a tie may hide a later change on file systems with coarse times
+  return a.st_mtim.tv_nsec > b.st_mtim.tv_nsec;
+}
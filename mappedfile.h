@@ -0,0 +1,51 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_MAPPEDFILE_H
+#define HEADER_MAPPEDFILE_H
+
+#include <string>
+
+/// A whole file mapped read-only into memory
+class MappedFile
+{
+private:
+  std::string _filename;
+  const char* _data;
+  size_t _size;
+
+public:
+  /// How the mapping will be read, passed on to the kernel as a
+  /// readahead hint
+  enum Access { SEQUENTIAL, RANDOM };
+
+  /// Maps \a filename, throwing if it can not be opened
+  MappedFile(const std::string& filename, Access access = SEQUENTIAL);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &x) = delete;
+  MappedFile& operator=(const MappedFile &x) = delete;
+
+  const std::string& filename() const { return _filename; }
+  const char* data() const { return _data; }
+  const char* end() const { return _data + _size; }
+  size_t size() const { return _size; }
+
+  /// True if \a filename exists and can be read
+  static bool exists(const std::string& filename);
+
+  /// True if \a filename is a regular file; pipes and devices can not be
+  /// mapped and are read as streams instead
+  static bool isRegular(const std::string& filename);
+
+  /// True if \a filename exists and \a other is missing or was last
+  /// modified strictly before it
+  static bool upToDate(const std::string& filename, const std::string& other);
+};
+
+#endif
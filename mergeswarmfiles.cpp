@@ -0,0 +1,77 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <unistd.h>
+
+#include "swarmmerge.h"
+#include "threadpool.h"
+
+void usage(int exit_code) {
+  cout << "mergeswarmfiles"
+#ifdef VERSION
+       << " -- " << VERSION
+#endif
+       << endl
+       << "Usage: " << endl
+       << "  mergeswarmfiles [-t threads] indirectory outdirectory" << endl
+       << "Merges the paradigm outputs under indirectory (*.fa, *.fa.gz,"
+       << " *.fa.zst" << endl
+       << "and binary *.ptb files) into outdirectory/merged_<pid>.out and"
+       << endl
+       << "merged_transpose_<pid>.out per pathway, as"
+       << " helperScripts/mergeSwarmFiles.py" << endl
+       << "does; each thread holds one pathway's files at a time." << endl;
+  exit(exit_code);
+}
+
+int main(int argc, char** argv) {
+  size_t threads = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "ht:")) != -1) {
+    switch (opt) {
+    case 't': threads = strtoul(optarg, NULL, 10); break;
+    case 'h': usage(0); break;
+    default: usage(2);
+    }
+  }
+  if (argc - optind != 2) {
+    usage(2);
+  }
+  string indir = argv[optind];
+  string outdir = argv[optind + 1];
+
+  try {
+    vector< string > files = findSwarmFiles(indir);
+    cout << "found " << files.size() << " files total" << endl;
+    map< string, vector< string > > groups = groupSwarmFiles(files);
+    cout << "grouped files into " << groups.size() << " groups" << endl;
+
+    vector< map< string, vector< string > >::const_iterator > order;
+    for (map< string, vector< string > >::const_iterator g = groups.begin();
+	 g != groups.end(); ++g) {
+      order.push_back(g);
+    }
+    ThreadPool pool(threads == 0 ? 1 : threads);
+    mutex printing;
+    pool.parallelFor(order.size(), [&](size_t i) {
+	{
+	  lock_guard< mutex > hold(printing);
+	  cout << "merging " << order[i]->second.size() << " files into "
+	       << order[i]->first << endl;
+	}
+	mergeSwarmGroup(order[i]->first, order[i]->second, outdir);
+      });
+  } catch (const std::exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
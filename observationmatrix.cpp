@@ -0,0 +1,83 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#include <algorithm>
+
+#include "observationmatrix.h"
+
+ObservationMatrix::ObservationMatrix()
+  : _vars(), _columns(), _byLabel(), _rows(0), _stride(0), _states()
+{
+}
+
+size_t ObservationMatrix::addVar(const Var& v)
+{
+  unordered_map< size_t, size_t >::const_iterator i = _columns.find(v.label());
+  if (i != _columns.end()) {
+    return i->second;
+  }
+  size_t column = _vars.size();
+  _vars.push_back(v);
+  _columns[v.label()] = column;
+  _byLabel.insert(upper_bound(_byLabel.begin(), _byLabel.end(), column,
+			      [this](size_t a, size_t b) {
+				return _vars[a] < _vars[b];
+			      }),
+		  column);
+
+  if (_vars.size() > _stride) {
+    // widen every row, doubling so that adding a file of columns to
+    // existing rows stays linear
+    size_t stride = max(_vars.size(), 2 * _stride);
+    vector< unsigned char > states(_rows * stride, Discretizer::NA);
+    for (size_t r = 0; r < _rows; ++r) {
+      copy(_states.begin() + r * _stride, _states.begin() + (r + 1) * _stride,
+	   states.begin() + r * stride);
+    }
+    _states.swap(states);
+    _stride = stride;
+  }
+  return column;
+}
+
+size_t ObservationMatrix::addRow()
+{
+  _states.resize((_rows + 1) * _stride, Discretizer::NA);
+  return _rows++;
+}
+
+void ObservationMatrix::clearRow(size_t row)
+{
+  fill(_states.begin() + row * _stride, _states.begin() + (row + 1) * _stride,
+       Discretizer::NA);
+}
+
+void ObservationMatrix::observed(size_t row,
+				 vector< pair< Var, size_t > >& out) const
+{
+  out.clear();
+  const unsigned char* states = _states.data() + row * _stride;
+  for (size_t k = 0; k < _byLabel.size(); ++k) {
+    size_t column = _byLabel[k];
+    if (states[column] != Discretizer::NA) {
+      out.push_back(make_pair(_vars[column], (size_t)states[column]));
+    }
+  }
+}
+
+Evidence ObservationMatrix::toEvidence() const
+{
+  vector< Evidence::Observation > samples(_rows);
+  vector< pair< Var, size_t > > obs;
+  for (size_t r = 0; r < _rows; ++r) {
+    observed(r, obs);
+    samples[r].insert(obs.begin(), obs.end());
+  }
+  return Evidence(samples);
+}
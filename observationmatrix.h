@@ -0,0 +1,67 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_OBSERVATIONMATRIX_H
+#define HEADER_OBSERVATIONMATRIX_H
+
+#include <unordered_map>
+#include <vector>
+#include <dai/evidence.h>
+
+#include "discretizer.h"
+
+using namespace std;
+using namespace dai;
+
+/// The discretized observations of every sample, one byte per sample
+/// and observation variable, with Discretizer::NA where a sample has no
+/// value.  Rows are samples in the order they were added; columns are
+/// observation variables.  Each row is contiguous, so clamping a sample
+/// reads a single run of bytes.
+class ObservationMatrix
+{
+private:
+  vector< Var > _vars;                      // by column
+  unordered_map< size_t, size_t > _columns; // var label -> column
+  vector< size_t > _byLabel;                // columns in Var order
+  size_t _rows;
+  size_t _stride;
+  vector< unsigned char > _states;
+
+public:
+  ObservationMatrix();
+
+  /// The column of \a v, added with NA for every row if it is new
+  size_t addVar(const Var& v);
+
+  /// Adds a row of NA and returns its index
+  size_t addRow();
+  /// Sets every observation of \a row back to NA, for reuse
+  void clearRow(size_t row);
+
+  size_t rows() const { return _rows; }
+  size_t columns() const { return _vars.size(); }
+  const Var& var(size_t column) const { return _vars[column]; }
+
+  unsigned char get(size_t row, size_t column) const {
+    return _states[row * _stride + column];
+  }
+  void set(size_t row, size_t column, unsigned char state) {
+    _states[row * _stride + column] = state;
+  }
+
+  /// Replaces \a out with the observed (variable, state) pairs of \a row,
+  /// in Var order
+  void observed(size_t row, vector< pair< Var, size_t > >& out) const;
+
+  /// The rows as libDAI evidence, for EM
+  Evidence toEvidence() const;
+};
+
+#endif
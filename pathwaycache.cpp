@@ -0,0 +1,349 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#include <cstring>
+#include <sstream>
+
+#include "binaryio.h"
+#include "common.h"
+#include "pathwaycache.h"
+
+const std::string PathwayCache::EXTENSION = ".pwb";
+
+namespace {
+
+const char MAGIC[8] = { 'P', 'D', 'G', 'M', 'P', 'W', 'B', '\0' };
+const unsigned int FORMAT_VERSION = 1;
+
+/// Every section starts on an 8 byte boundary, so the integer and Real
+/// arrays can be read in place from the page aligned mapping
+struct Header {
+  char magic[8];
+  unsigned int version;
+  unsigned int real_size;
+  unsigned long long key;
+  unsigned long long symbols;      // interned names
+  unsigned long long symbol_bytes; // their total length
+  unsigned long long nodes;
+  unsigned long long edges;
+  unsigned long long labels;       // distinct edge labels
+  unsigned long long values;       // factor table entries
+};
+
+/// Section sizes in file order; used by both the writer and the reader
+size_t layoutSize(const Header& h) {
+  size_t n = alignSection(sizeof(Header));
+  n += alignSection((h.symbols + 1) * sizeof(unsigned long long)); // name offsets
+  n += alignSection(h.symbol_bytes);                               // name chars
+  n += alignSection(h.symbols * sizeof(unsigned int));             // entity types
+  n += alignSection(h.nodes * 2 * sizeof(unsigned int));           // nodes
+  n += alignSection(h.nodes * sizeof(unsigned long long));         // child order
+  n += alignSection((h.nodes + 1) * sizeof(unsigned long long));   // parent offsets
+  n += alignSection(h.edges * sizeof(unsigned int));               // parent index
+  n += alignSection(h.edges * sizeof(PathwayTab::EdgeLabel));      // parent label
+  n += alignSection(h.labels * sizeof(unsigned int));              // edge labels
+  n += alignSection((h.nodes + 1) * sizeof(unsigned long long));   // value offsets
+  n += alignSection(h.values * sizeof(Real));                      // values
+  return n;
+}
+
+/// True if no count is larger than the file, so layoutSize can not
+/// overflow
+bool countsFit(const Header& h, size_t size)
+{
+  return h.symbols <= size && h.symbol_bytes <= size && h.nodes <= size
+    && h.edges <= size && h.labels <= size && h.values <= size;
+}
+
+/// True if every one of the \a n \a ids is below \a limit (or is
+/// \a allowed)
+template< typename T >
+bool validIds(const T* ids, size_t n, unsigned long long limit,
+	      unsigned long long allowed = ~0ULL)
+{
+  for (size_t i = 0; i < n; ++i) {
+    if (ids[i] >= limit && ids[i] != allowed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Checks every offset and id of a cache whose header and size are
+/// right, so that read() can use them without bounds checks
+bool validSections(const Header& h, const char* data)
+{
+  SectionReader r(data);
+  r.take< Header >(1);
+  const unsigned long long* name_offsets =
+    r.take< unsigned long long >(h.symbols + 1);
+  r.take< char >(h.symbol_bytes);
+  const unsigned int* entity_types = r.take< unsigned int >(h.symbols);
+  const unsigned int* nodes = r.take< unsigned int >(2 * h.nodes);
+  const unsigned long long* child_order =
+    r.take< unsigned long long >(h.nodes);
+  const unsigned long long* parent_offsets =
+    r.take< unsigned long long >(h.nodes + 1);
+  const unsigned int* parent_index = r.take< unsigned int >(h.edges);
+  const PathwayTab::EdgeLabel* parent_label =
+    r.take< PathwayTab::EdgeLabel >(h.edges);
+  const unsigned int* edge_labels = r.take< unsigned int >(h.labels);
+  const unsigned long long* value_offsets =
+    r.take< unsigned long long >(h.nodes + 1);
+
+  if (!validOffsets(name_offsets, h.symbols, h.symbol_bytes)
+      || !validIds(entity_types, h.symbols, h.symbols, SymbolTable::NONE)
+      || !validIds(nodes, 2 * h.nodes, h.symbols)
+      || !validIds(child_order, h.nodes, h.nodes)
+      || !validOffsets(parent_offsets, h.nodes, h.edges)
+      || !validIds(parent_index, h.edges, h.nodes)
+      || !validIds(parent_label, h.edges, h.labels)
+      || !validIds(edge_labels, h.labels, h.symbols)
+      || !validOffsets(value_offsets, h.nodes, h.values)) {
+    return false;
+  }
+  // the child order must visit every node once
+  vector< bool > seen(h.nodes, false);
+  for (size_t i = 0; i < h.nodes; ++i) {
+    if (seen[child_order[i]]) {
+      return false;
+    }
+    seen[child_order[i]] = true;
+  }
+  return true;
+}
+
+/// 64 bit FNV-1a
+class Hash {
+  unsigned long long _h;
+public:
+  Hash() : _h(14695981039346656037ULL) {}
+  void add(const char* p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      _h ^= (unsigned char)p[i];
+      _h *= 1099511628211ULL;
+    }
+  }
+  void add(const std::string& s) {
+    add(s.data(), s.size() + 1); // keep the terminator as a separator
+  }
+  unsigned long long value() const { return _h; }
+};
+
+}
+
+unsigned long long PathwayCache::key(const std::string& pathway_filename,
+				     const PropertySet& props)
+{
+  Hash h;
+  unsigned int version[2] = { FORMAT_VERSION, sizeof(Real) };
+  h.add(reinterpret_cast< const char* >(version), sizeof(version));
+  h.add(PathwayTab::DEFAULT_INTERACTION_MAP);
+  h.add(PathwayTab::CENTRAL_DOGMA);
+  ostringstream p;
+  p << props;
+  h.add(p.str());
+  MappedFile tab(pathway_filename);
+  h.add(tab.data(), tab.size());
+  return h.value();
+}
+
+shared_ptr< const MappedFile >
+PathwayCache::open(const std::string& cache_filename, unsigned long long key)
+{
+  if (!MappedFile::exists(cache_filename)) {
+    return shared_ptr< const MappedFile >();
+  }
+  shared_ptr< const MappedFile > m(new MappedFile(cache_filename));
+  const Header* h = reinterpret_cast< const Header* >(m->data());
+  if (m->size() < sizeof(Header)
+      || memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0
+      || h->version != FORMAT_VERSION
+      || h->real_size != sizeof(Real)
+      || h->key != key
+      || !countsFit(*h, m->size())
+      || m->size() != layoutSize(*h)) {
+    if (VERBOSE) {
+      cerr << "Ignoring out of date pathway cache " << cache_filename << endl;
+    }
+    return shared_ptr< const MappedFile >();
+  }
+  if (!validSections(*h, m->data())) {
+    cerr << "!! Ignoring damaged pathway cache " << cache_filename << endl;
+    return shared_ptr< const MappedFile >();
+  }
+  return m;
+}
+
+void PathwayCache::write(const PathwayTab& pathway,
+			 const std::string& cache_filename,
+			 unsigned long long key)
+{
+  pathway.checkFrozen();
+
+  Header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = FORMAT_VERSION;
+  h.real_size = sizeof(Real);
+  h.key = key;
+  h.symbols = pathway._symbols.size();
+  h.nodes = pathway._nodes.size();
+  h.edges = pathway._parentIndex.size();
+  h.labels = pathway._edgeLabels.size();
+
+  vector< unsigned long long > name_offsets(1, 0);
+  std::string names;
+  vector< unsigned int > entity_types;
+  for (size_t s = 0; s < h.symbols; ++s) {
+    names += pathway._symbols.name(s);
+    name_offsets.push_back(names.size());
+    entity_types.push_back(pathway.entityType(s));
+  }
+  h.symbol_bytes = names.size();
+
+  if (pathway._symbols.find(PathwayTab::OBSERVATION_INTERACTION)
+      != SymbolTable::NONE) {
+    THROW("Can not compile a pathway with evidence attached");
+  }
+
+  vector< unsigned int > nodes;
+  for (size_t i = 0; i < h.nodes; ++i) {
+    nodes.push_back(pathway._nodes[i].first);
+    nodes.push_back(pathway._nodes[i].second);
+  }
+
+  vector< unsigned long long > value_offsets(1, 0);
+  vector< Real > values;
+  for (size_t i = 0; i < h.nodes; ++i) {
+    const size_t pbegin = pathway._parentOffsets[i];
+    const size_t pend = pathway._parentOffsets[i + 1];
+    if (pbegin != pend) {
+      vector< string > edge_types;
+      for (size_t p = pbegin; p < pend; ++p) {
+	const size_t label = pathway._edgeLabels[pathway._parentLabel[p]];
+	edge_types.push_back(pathway._symbols.name(label));
+      }
+      pathway.generateFactorValues(i, edge_types, values);
+    }
+    value_offsets.push_back(values.size());
+  }
+  h.values = values.size();
+
+  AtomicOutputFile out(cache_filename);
+  SectionWriter w(out.stream());
+  w.put(&h, 1);
+  w.put(name_offsets);
+  w.put(names.data(), names.size());
+  w.put(entity_types);
+  w.put(nodes);
+  vector< unsigned long long > child_order(pathway._childOrder.begin(),
+					   pathway._childOrder.end());
+  w.put(child_order);
+  vector< unsigned long long > parent_offsets(pathway._parentOffsets.begin(),
+					      pathway._parentOffsets.end());
+  w.put(parent_offsets);
+  w.put(pathway._parentIndex);
+  w.put(pathway._parentLabel);
+  w.put(pathway._edgeLabels);
+  w.put(value_offsets);
+  w.put(values);
+  out.commit();
+}
+
+PathwayTab PathwayCache::load(const std::string& pathway_filename,
+			      const PropertySet& props,
+			      bool write_cache)
+{
+  std::string cache_filename = pathway_filename + EXTENSION;
+  unsigned long long k = key(pathway_filename, props);
+  shared_ptr< const MappedFile > compiled = open(cache_filename, k);
+  if (compiled) {
+    if (VERBOSE) {
+      cerr << "Using compiled pathway " << cache_filename << endl;
+    }
+    return PathwayTab::create(compiled, props);
+  }
+  PathwayTab pathway = PathwayTab::create(pathway_filename, props);
+  if (write_cache) {
+    write(pathway, cache_filename, k);
+  }
+  return pathway;
+}
+
+void PathwayCache::read(shared_ptr< const MappedFile > compiled,
+			PathwayTab& pathway)
+{
+  const Header& h = *reinterpret_cast< const Header* >(compiled->data());
+  SectionReader r(compiled->data());
+  r.take< Header >(1);
+  const unsigned long long* name_offsets =
+    r.take< unsigned long long >(h.symbols + 1);
+  const char* names = r.take< char >(h.symbol_bytes);
+  for (size_t s = 0; s < h.symbols; ++s) {
+    std::string_view name(names + name_offsets[s],
+			  name_offsets[s + 1] - name_offsets[s]);
+    if (pathway._symbols.intern(name) != s) {
+      THROW("Duplicate name in pathway cache " + compiled->filename());
+    }
+  }
+
+  // the generators and interaction map intern their names after the
+  // cached ones, so the cached ids stay valid
+  istringstream is(PathwayTab::DEFAULT_INTERACTION_MAP);
+  pathway.initialize(is);
+
+  const unsigned int* entity_types = r.take< unsigned int >(h.symbols);
+  pathway._entityTypes.assign(entity_types, entity_types + h.symbols);
+
+  const unsigned int* nodes = r.take< unsigned int >(2 * h.nodes);
+  pathway._nodes.reserve(h.nodes);
+  pathway._nodemap.reserve(h.nodes);
+  for (size_t i = 0; i < h.nodes; ++i) {
+    pathway._nodes.push_back(make_pair(nodes[2 * i], nodes[2 * i + 1]));
+    pathway._nodemap[PathwayTab::packKey(nodes[2 * i], nodes[2 * i + 1])] = i;
+  }
+
+  const unsigned long long* child_order =
+    r.take< unsigned long long >(h.nodes);
+  pathway._childOrder.assign(child_order, child_order + h.nodes);
+  const unsigned long long* parent_offsets =
+    r.take< unsigned long long >(h.nodes + 1);
+  pathway._parentOffsets.assign(parent_offsets, parent_offsets + h.nodes + 1);
+  const unsigned int* parent_index = r.take< unsigned int >(h.edges);
+  pathway._parentIndex.assign(parent_index, parent_index + h.edges);
+  const PathwayTab::EdgeLabel* parent_label =
+    r.take< PathwayTab::EdgeLabel >(h.edges);
+  pathway._parentLabel.assign(parent_label, parent_label + h.edges);
+  const unsigned int* edge_labels = r.take< unsigned int >(h.labels);
+  pathway._edgeLabels.assign(edge_labels, edge_labels + h.labels);
+
+  // the mutable adjacency lists, in CSR order, for later additions
+  pathway._parents.resize(h.nodes);
+  for (size_t i = 0; i < h.nodes; ++i) {
+    for (size_t p = parent_offsets[i]; p < parent_offsets[i + 1]; ++p) {
+      pathway._edgemap[PathwayTab::packKey(i, parent_index[p])] =
+	pathway._parents[i].size();
+      pathway._parents[i].push_back(PathwayTab::Edge(parent_index[p],
+						     edge_labels[parent_label[p]]));
+    }
+  }
+  pathway._frozen = true;
+
+  pathway._compiledNodes = h.nodes;
+  pathway._compiledOffsets = r.take< unsigned long long >(h.nodes + 1);
+  pathway._compiledValues = r.take< Real >(h.values);
+  pathway._compiled = compiled;
+}
+
+PathwayTab::PathwayTab(shared_ptr< const MappedFile > compiled,
+		       const PropertySet& props)
+  : PathwayTab(GeneProteinExpressionModel(CENTRAL_DOGMA), props) {
+  PathwayCache::read(compiled, *this);
+}
@@ -0,0 +1,58 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_PATHWAYCACHE_H
+#define HEADER_PATHWAYCACHE_H
+
+#include <memory>
+#include <string>
+
+#include "pathwaytab.h"
+#include "mappedfile.h"
+
+/// Compiled pathway files (path.tab.pwb): the interned names, the node
+/// table, the CSR parent graph and the factor table of every pathway
+/// node, in 8 byte aligned sections of a read-only mapping.  Loading
+/// skips parsing, splitting and factor generation, but still copies the
+/// names, nodes and parent graph into the PathwayTab, which evidence
+/// extends later; only the factor tables are used in place.
+/// A cache is keyed by a hash of the pathway file, the pathway []
+/// properties and the built-in interaction map and dogma.
+class PathwayCache
+{
+public:
+  static const std::string EXTENSION; // = ".pwb"
+
+  /// The key a cache of \a pathway_filename loaded with \a props must have
+  static unsigned long long key(const std::string& pathway_filename,
+				const PropertySet& props);
+
+  /// Maps \a cache_filename if it exists, was written with \a key and
+  /// all its offsets and ids are in range, otherwise returns NULL
+  static shared_ptr< const MappedFile > open(const std::string& cache_filename,
+					     unsigned long long key);
+
+  /// Compiles \a pathway, which must be frozen and must not hold any
+  /// observation nodes, to \a cache_filename
+  static void write(const PathwayTab& pathway,
+		    const std::string& cache_filename,
+		    unsigned long long key);
+
+  /// Loads \a pathway_filename from its cache when that is up to date,
+  /// otherwise parses it and, if \a write_cache is set, compiles it
+  static PathwayTab load(const std::string& pathway_filename,
+			 const PropertySet& props,
+			 bool write_cache);
+
+  /// Fills a bare \a pathway from a file returned by open()
+  static void read(shared_ptr< const MappedFile > compiled,
+		   PathwayTab& pathway);
+};
+
+#endif
@@ -0,0 +1,49 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#include "pathwaycache.h"
+#include "pathwaycompiler.h"
+
+vector< unique_ptr< CompiledPathway > >
+compilePathways(const vector< std::string >& pathway_files,
+		const RunConfiguration& conf,
+		ThreadPool& pool,
+		bool write_cache)
+{
+  const PropertySet& props = conf.pathwayProps();
+  const RunConfiguration::EMSteps steps = conf.emSteps();
+
+  // each task only touches its own slot; the pathways share nothing
+  // mutable, only the built-in factor generators
+  vector< unique_ptr< CompiledPathway > > out(pathway_files.size());
+  pool.parallelFor(pathway_files.size(), [&](size_t i) {
+      const std::string& f = pathway_files[i];
+      out[i].reset(new CompiledPathway(f, PathwayCache::load(f, props,
+							       write_cache)));
+      CompiledPathway& c = *out[i];
+      vector< Factor > factors;
+      c.var_orders = c.pathway.constructFactors(steps, factors, c.msteps);
+      c.graph = FactorGraph(factors);
+    });
+  return out;
+}
+
+void compilePathwayCaches(const vector< std::string >& pathway_files,
+			  const PropertySet& props,
+			  ThreadPool& pool)
+{
+  pool.parallelFor(pathway_files.size(), [&](size_t i) {
+      const std::string& f = pathway_files[i];
+      std::string cache_filename = f + PathwayCache::EXTENSION;
+      unsigned long long k = PathwayCache::key(f, props);
+      if (!PathwayCache::open(cache_filename, k)) {
+	PathwayCache::write(PathwayTab::create(f, props), cache_filename, k);
+      }
+    });
+}
@@ -0,0 +1,53 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_PATHWAYCOMPILER_H
+#define HEADER_PATHWAYCOMPILER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <dai/factorgraph.h>
+
+#include "configuration.h"
+#include "pathwaytab.h"
+#include "threadpool.h"
+
+/// A pathway and the factor graph built from it
+struct CompiledPathway
+{
+  std::string filename;
+  PathwayTab pathway;
+  FactorGraph graph;
+  vector< MaximizationStep > msteps;
+  vector< vector < SharedParameters::FactorOrientations > > var_orders;
+
+  CompiledPathway(const std::string& f, PathwayTab&& p)
+    : filename(f), pathway(move(p)), graph(), msteps(), var_orders() {}
+};
+
+/// Loads every file of \a pathway_files and builds its factor graph on
+/// \a pool, with the pathway [] and em_step settings of \a conf.  Each
+/// pathway is loaded through PathwayCache::load, which compiles it to its
+/// cache file when \a write_cache is set.  Results are in the order of
+/// \a pathway_files; the first error stops the batch and is rethrown.
+vector< unique_ptr< CompiledPathway > >
+compilePathways(const vector< std::string >& pathway_files,
+		const RunConfiguration& conf,
+		ThreadPool& pool,
+		bool write_cache=false);
+
+/// Compiles each file of \a pathway_files whose cache is missing or out
+/// of date on \a pool, without building its factor graph; errors are
+/// handled as by compilePathways
+void compilePathwayCaches(const vector< std::string >& pathway_files,
+			  const PropertySet& props,
+			  ThreadPool& pool);
+
+#endif
@@ -10,9 +10,16 @@
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
 
 #include <dai/index.h>
+#include "common.h"
+#include "compressedio.h"
+#include "mappedfile.h"
 #include "pathwaytab.h"
+#include "tabtokenizer.h"
 
 using namespace std;
 
@@ -123,105 +130,193 @@ void AllMembersNeededFactorGenerator::generateValues(const vector< string >& edg
     }
   }
 }
+namespace {
+string readAll(istream& is) {
+  return string(istreambuf_iterator< char >(is), istreambuf_iterator< char >());
+}
+
+/// The built-in generators have no per-pathway state, so one instance
+/// of each serves every pathway
+template< class G >
+shared_ptr< const FactorGenerator > sharedGenerator() {
+  static const shared_ptr< const FactorGenerator > g = make_shared< const G >();
+  return g;
+}
+}
+
 void readInteractionMap(istream& is,
 			map< string, vector< string > >& out_imap) {
-  string line;
-  while(getline(is, line)) {
-    vector< string > vals;
-    dai::tokenizeString(line, vals);
+  string contents = readAll(is);
+  TabTokenizer lines(contents.data(), contents.data() + contents.size());
+  vector< string_view > vals;
+  while (lines.next(vals)) {
     if (vals.size() != 4) {
       THROW("Interaction map lines must have 4 entries");
     }
-    string interaction = *vals.begin();
-    vals.erase(vals.begin());
-    out_imap[interaction] = vals;
+    out_imap[string(vals[0])] = vector< string >(vals.begin() + 1, vals.end());
   }
 }
 
 GeneProteinExpressionModel::GeneProteinExpressionModel(istream& is)
   : _states(), _steps() {
-  string line;
-  while(getline(is, line)) {
-    vector<string> vals;
-    dai::tokenizeString(line, vals);
+  string contents = readAll(is);
+  read(contents);
+}
+
+GeneProteinExpressionModel::GeneProteinExpressionModel(const string& dogma)
+  : _states(), _steps() {
+  read(dogma);
+}
+
+void GeneProteinExpressionModel::read(const string& dogma) {
+  TabTokenizer lines(dogma.data(), dogma.data() + dogma.size());
+  vector< string_view > vals;
+  while (lines.next(vals)) {
     if (vals.size() != 3) {
       THROW("Must have three values per line in central dogma");
     }
-    _steps.insert(vals[2]);
-    _states.insert(vals[0]);
-    _states.insert(vals[1]);
+    _steps.insert(string(vals[2]));
+    _states.insert(string(vals[0]));
+    _states.insert(string(vals[1]));
   }
 }
 
-void GeneProteinExpressionModel::addGeneDogma(const string& genename,
+void GeneProteinExpressionModel::addGeneDogma(SymbolTable::Symbol gene,
 					      PathwayTab& pathway_graph) {
   set< string >::iterator state_iterator = _states.begin();
   for ( ; state_iterator != _states.end(); ++state_iterator) {
-    PathwayTab::Node node(genename, *state_iterator);
-    pathway_graph.addNode(node);
+    pathway_graph.addNode(gene, pathway_graph.intern(*state_iterator));
   }
   set< string >::iterator step_iterator = _steps.begin();
   for ( ; step_iterator != _steps.end(); ++step_iterator) {
-    pathway_graph.addInteraction(genename, genename, *step_iterator);
+    pathway_graph.addInteraction(gene, gene,
+				 pathway_graph.intern(*step_iterator));
   }
 }
 
 
-PathwayTab::PathwayTab(istream& pathway_stream,
-		       istream& imap_stream,
-		       istream& dogma_stream,
+PathwayTab::PathwayTab(const GeneProteinExpressionModel& dogma,
 		       const PropertySet& props)
-  : _nodemap(),
-    _nodevector(),
+  : _symbols(),
+    _active(SymbolTable::NONE),
+    _protein(SymbolTable::NONE),
+    _nodemap(),
+    _nodes(),
     _parents(),
-    _entities(),
-    _dogma(dogma_stream),
+    _edgemap(),
+    _entityTypes(),
+    _frozen(false),
+    _childOrder(),
+    _parentOffsets(),
+    _parentIndex(),
+    _parentLabel(),
+    _edgeLabels(),
+    _dogma(dogma),
     _imap(),
     _props(props),
     _factorGenLookup(),
-    _defaultFactorGen(new RepressorDominatesVoteFactorGenerator()) {
-  vector< vector< string > > entity_lines;
-  vector< vector< string > > interaction_lines;
-  string line;
+    _defaultFactorGen(sharedGenerator< RepressorDominatesVoteFactorGenerator >()),
+    _compiled(),
+    _compiledNodes(0),
+    _compiledOffsets(NULL),
+    _compiledValues(NULL) {
+}
+
+void PathwayTab::initialize(istream& imap_stream) {
+  _active = _symbols.intern("active");
+  _protein = _symbols.intern("protein");
+
+  string imap = readAll(imap_stream);
+  TabTokenizer lines(imap.data(), imap.data() + imap.size());
+  vector< string_view > vals;
+  while (lines.next(vals)) {
+    if (vals.size() != 4) {
+      THROW("Interaction map lines must have 4 entries");
+    }
+    Interaction& i = _imap[_symbols.intern(vals[0])];
+    i.from_type = _symbols.intern(vals[1]);
+    i.to_type = _symbols.intern(vals[2]);
+    i.label = _symbols.intern(vals[3]);
+  }
 
-  readInteractionMap(imap_stream, _imap);
+  addFactorGenerator("family","active",
+		     sharedGenerator< SingleMemberNeededFactorGenerator >());
+  addFactorGenerator("complex","active",
+		     sharedGenerator< AllMembersNeededFactorGenerator >());
+}
 
-  while(getline(pathway_stream, line)) {
-    vector< string > vals;
-    dai::tokenizeString(line, vals);
+PathwayTab::PathwayTab(const char* pathway_begin,
+		       const char* pathway_end,
+		       istream& imap_stream,
+		       istream& dogma_stream,
+		       const PropertySet& props)
+  : PathwayTab(GeneProteinExpressionModel(dogma_stream), props) {
+  initialize(imap_stream);
+
+  // entities first, so interactions can refer to any entity in the file
+  vector< string_view > vals;
+  TabTokenizer entities(pathway_begin, pathway_end);
+  while (entities.next(vals)) {
     if (vals.size() == 2) {
-      entity_lines.push_back(vals);
-    } else if (vals.size() == 3) {
-      interaction_lines.push_back(vals);
-    } else {
+      addEntity(_symbols.intern(vals[1]), _symbols.intern(vals[0]));
+    } else if (vals.size() != 3) {
       THROW("Must have either two or three entries per line");
     }
   }
-  vector< vector< string > >::iterator v = entity_lines.begin();
-  for ( ; v != entity_lines.end(); ++v ) {
-    addEntity(v->at(1), v->at(0));
-  }
-  for (v = interaction_lines.begin(); v != interaction_lines.end(); ++v) {
-    addInteraction(v->at(0), v->at(1), v->at(2));
+  TabTokenizer interactions(pathway_begin, pathway_end);
+  while (interactions.next(vals)) {
+    if (vals.size() == 3) {
+      addInteraction(_symbols.intern(vals[0]), _symbols.intern(vals[1]),
+		     _symbols.intern(vals[2]));
+    }
   }
 
-  addFactorGenerator("family","active",new SingleMemberNeededFactorGenerator());
-  addFactorGenerator("complex","active",new AllMembersNeededFactorGenerator());
-
   if (_props.hasKey("max_in_degree")) {
     int max_degree = props.getStringAs<int>("max_in_degree");
     splitHighInDegree(max_degree);
   }
+  freeze();
+}
+
+PathwayTab PathwayTab::create(istream& pathway_stream,
+			      const PropertySet& props,
+			      istream* imap_stream,
+			      istream* dogma_stream) {
+  istringstream is(DEFAULT_INTERACTION_MAP);
+  istringstream ds(CENTRAL_DOGMA);
+  if (imap_stream == NULL) {
+    imap_stream = &is;
+  }
+  if (dogma_stream == NULL) {
+    dogma_stream = &ds;
+  }
+  string contents = readAll(pathway_stream);
+  return PathwayTab(contents.data(), contents.data() + contents.size(),
+		    *imap_stream, *dogma_stream, props);
+}
+
+PathwayTab PathwayTab::create(const string& pathway_filename,
+			      const PropertySet& props) {
+  TextContents tab(pathway_filename);
+  istringstream is(DEFAULT_INTERACTION_MAP);
+  istringstream ds(CENTRAL_DOGMA);
+  return PathwayTab(tab.data(), tab.end(), is, ds, props);
 }
 
 void PathwayTab::addEntity(const string& entity, const string& type) {
-  if (_entities.count(entity) == 0) {
-    _entities[entity] = type;
-    if (type == "protein") {
+  addEntity(_symbols.intern(entity), _symbols.intern(type));
+}
+
+void PathwayTab::addEntity(Symbol entity, Symbol type) {
+  if (entityType(entity) == SymbolTable::NONE) {
+    if (_entityTypes.size() <= entity) {
+      _entityTypes.resize(entity + 1, SymbolTable::NONE);
+    }
+    _entityTypes[entity] = type;
+    if (type == _protein) {
       _dogma.addGeneDogma(entity, *this);
     } else {
-      Node n(entity, "active");
-      addNode(n);
+      addNode(entity, _active);
     }
   }
 }
@@ -229,126 +324,178 @@ void PathwayTab::addEntity(const string& entity, const string& type) {
 Var PathwayTab::addObservationNode(const string& entity,
 				   const string& on_type,
 				   const string& obs_type) {
-  Node obs_node(entity, obs_type);
-  Node hidden_node;
-  addNode(obs_node);
-  getAppropriateEntityNode(entity, on_type, hidden_node);
-  addEdge(hidden_node, obs_node, OBSERVATION_INTERACTION);
-
-  return Var(_nodemap[obs_node], VARIABLE_DIMENSION);
+  Symbol e = _symbols.intern(entity);
+  size_t obs_node = addNode(e, _symbols.intern(obs_type));
+  pair< Symbol, Symbol > hidden;
+  hidden = getAppropriateEntityNode(e, _symbols.intern(on_type));
+  size_t hidden_node = addNode(hidden.first, hidden.second);
+  addEdge(hidden_node, obs_node, _symbols.intern(OBSERVATION_INTERACTION));
+
+  return Var(obs_node, VARIABLE_DIMENSION);
 }
 
 void PathwayTab::addInteraction(const string& entity_from,
 				const string& entity_to,
 				const string& interaction) {
-  if (_imap.count(interaction) == 0) {
-    THROW("Unrecognized interaction type: " + interaction);
-  }
-  vector< string > i = _imap[interaction];
-  assert(i.size() == 3);
-  addEntity(entity_from);
-  addEntity(entity_to);
-  Node node_from;
-  Node node_to;
-  getAppropriateEntityNode(entity_from, i[0], node_from);
-  getAppropriateEntityNode(entity_to, i[1], node_to);
+  addInteraction(_symbols.intern(entity_from), _symbols.intern(entity_to),
+		 _symbols.intern(interaction));
+}
+
+void PathwayTab::addInteraction(Symbol entity_from,
+				Symbol entity_to,
+				Symbol interaction) {
+  unordered_map< Symbol, Interaction >::const_iterator im;
+  im = _imap.find(interaction);
+  if (im == _imap.end()) {
+    THROW("Unrecognized interaction type: " + _symbols.name(interaction));
+  }
+  const Interaction& i = im->second;
+  addEntity(entity_from, _protein);
+  addEntity(entity_to, _protein);
+  pair< Symbol, Symbol > node_from;
+  pair< Symbol, Symbol > node_to;
+  node_from = getAppropriateEntityNode(entity_from, i.from_type);
+  node_to = getAppropriateEntityNode(entity_to, i.to_type);
   if (node_from == node_to) {
     return;
   }
-  addNode(node_from);
-  addNode(node_to);
-  addEdge(node_from, node_to, i[2]);
+  size_t from = addNode(node_from.first, node_from.second);
+  size_t to = addNode(node_to.first, node_to.second);
+  addEdge(from, to, i.label);
+}
+
+size_t PathwayTab::addNode(Symbol entity, Symbol sub_type) {
+  pair< unordered_map< unsigned long long, size_t >::iterator, bool > ins;
+  ins = _nodemap.insert(make_pair(packKey(entity, sub_type), _nodes.size()));
+  if (ins.second) {
+    _nodes.push_back(make_pair(entity, sub_type));
+    _parents.push_back(vector< Edge >());
+    _frozen = false;
+  }
+  return ins.first->second;
 }
 
 void PathwayTab::addNode(Node nodename) {
-  if (_nodemap.count(nodename) == 0) {
-    map< Node, string > empty;
-    _nodemap[nodename] = _nodevector.size();
-    _nodevector.push_back(nodename);
-    _parents[nodename] = empty;
+  addNode(_symbols.intern(nodename.first), _symbols.intern(nodename.second));
+}
+
+void PathwayTab::addEdge(size_t from, size_t to, Symbol lbl) {
+  pair< unordered_map< unsigned long long, size_t >::iterator, bool > ins;
+  ins = _edgemap.insert(make_pair(packKey(to, from), _parents[to].size()));
+  if (ins.second) {
+    _parents[to].push_back(Edge(from, lbl));
+  } else {
+    _parents[to][ins.first->second].label = lbl;
   }
+  _frozen = false;
 }
 
 void PathwayTab::addEdge(const Node& from, const Node& to, const string& lbl) {
-  _parents[to][from] = lbl;
+  size_t f = addNode(_symbols.intern(from.first), _symbols.intern(from.second));
+  size_t t = addNode(_symbols.intern(to.first), _symbols.intern(to.second));
+  addEdge(f, t, _symbols.intern(lbl));
 }
 
-void PathwayTab::getAppropriateEntityNode(const string& entity,
-					  const string& species,
-					  Node& out_node) {
-  out_node.first = entity;
-  if (_entities[entity] == "protein") {
-    out_node.second = species;
-  } else {
-    out_node.second = "active";
+void PathwayTab::clearParents(size_t node) {
+  vector< Edge >& pvec = _parents[node];
+  for (size_t i = 0; i < pvec.size(); ++i) {
+    _edgemap.erase(packKey(node, pvec[i].parent));
   }
+  pvec.clear();
+  _frozen = false;
+}
+
+pair< SymbolTable::Symbol, SymbolTable::Symbol >
+PathwayTab::getAppropriateEntityNode(Symbol entity, Symbol species) const {
+  return make_pair(entity, entityType(entity) == _protein ? species : _active);
+}
+
+size_t PathwayTab::getNodeIndex(const Node& n) const {
+  unordered_map< unsigned long long, size_t >::const_iterator i;
+  i = _nodemap.find(packKey(_symbols.find(n.first), _symbols.find(n.second)));
+  if (i == _nodemap.end()) {
+    THROW("Unknown node " + n.first + " " + n.second);
+  }
+  return i->second;
+}
+
+/// Orders nodes by entity name and then sub-type name, the order in
+/// which factors are generated and parents are listed within a factor
+bool PathwayTab::nodeLess(size_t a, size_t b) const {
+  const pair< Symbol, Symbol >& na = _nodes[a];
+  const pair< Symbol, Symbol >& nb = _nodes[b];
+  if (na.first != nb.first) {
+    return _symbols.name(na.first) < _symbols.name(nb.first);
+  }
+  return _symbols.name(na.second) < _symbols.name(nb.second);
+}
+
+void PathwayTab::sortByNode(vector< Edge >& edges) const {
+  sort(edges.begin(), edges.end(), [this](const Edge& a, const Edge& b) {
+      return nodeLess(a.parent, b.parent);
+    });
+}
+
+vector< size_t > PathwayTab::sortedNodes() const {
+  vector< size_t > order(_nodes.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+      return nodeLess(a, b);
+    });
+  return order;
 }
 
 void PathwayTab::addFactorGenerator(const string& entity_type,
 				    const string& node_type,
-				    FactorGenerator* factor_gen) {
-  pair< string, string > entry(entity_type, node_type);
-  _factorGenLookup[entry] = factor_gen;
+				    shared_ptr< const FactorGenerator > factor_gen) {
+  unsigned long long entry = packKey(_symbols.intern(entity_type),
+				     _symbols.intern(node_type));
+  _factorGenLookup[entry] = move(factor_gen);
 }
 
 void PathwayTab::printNodeMap(ostream& to, const string& prefix) {
-  for (size_t i = 0; i < _nodevector.size(); ++i) {
+  for (size_t i = 0; i < _nodes.size(); ++i) {
     to << prefix << i
-       << '\t' << _nodevector[i].first
-       << '\t' << _nodevector[i].second << endl;
+       << '\t' << _symbols.name(_nodes[i].first)
+       << '\t' << _symbols.name(_nodes[i].second) << endl;
   }
 }
 
 void PathwayTab::printDaiFactorSection(ostream& to) {
+  checkFrozen();
   size_t factor_count = 0;
-  map< Node, map< Node, string > >::iterator c_iter = _parents.begin();
-  vector< Node > corder;
-  corder.reserve(_parents.size());
-  for ( ; c_iter != _parents.end(); ++c_iter) {
-    factor_count += (c_iter->second.size() > 0);
-    corder.push_back(c_iter->first);
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    factor_count += (_parentOffsets[i + 1] > _parentOffsets[i]);
   }
   to.precision(6);
   to << fixed;
   to << factor_count << endl;
 
-  sort(corder.begin(), corder.end());
-  vector< Node >::iterator corder_iter = corder.begin();
-  for ( ; corder_iter != corder.end(); ++corder_iter) {
-    map< Node, string >& pmap = _parents[*corder_iter];
-
-    if (pmap.size() == 0) {
+  vector< size_t >::iterator corder_iter = _childOrder.begin();
+  for ( ; corder_iter != _childOrder.end(); ++corder_iter) {
+    const size_t pbegin = _parentOffsets[*corder_iter];
+    const size_t pend = _parentOffsets[*corder_iter + 1];
+    if (pbegin == pend) {
       continue;
     }
 
-    vector< Node > parents;
     vector< string > edge_types;
 
-
-    if (pmap.count(*corder_iter) > 0) {
-      // is this causing a seg fault?
-      // pmap.erase(c_iter->first);
-    }
-    map< Node, string >::iterator p_iter =  pmap.begin();
-    for ( ; p_iter != pmap.end(); ++p_iter) {
-      parents.push_back(p_iter->first);
-    }
-    sort(parents.begin(), parents.end());
-
     /// Factor line: number of variables in factor
-    to << endl << (parents.size() + 1) << endl;
+    to << endl << (pend - pbegin + 1) << endl;
     /// Output variable ids
-    to << _nodemap[*corder_iter];
-    vector< Node >::iterator pnode_iter = parents.begin();
-    for ( ; pnode_iter != parents.end(); ++pnode_iter) {
-      to << ' ' << _nodemap[*pnode_iter];
-      edge_types.push_back(pmap[*pnode_iter]);
+    to << *corder_iter;
+    for (size_t p = pbegin; p < pend; ++p) {
+      to << ' ' << _parentIndex[p];
+      edge_types.push_back(_symbols.name(_edgeLabels[_parentLabel[p]]));
     }
     to << endl;
     /// Output variable dimensions
     to << VARIABLE_DIMENSION;
     size_t total_dimension = VARIABLE_DIMENSION;
-    for (size_t i = 0; i < parents.size(); ++i) {
+    for (size_t p = pbegin; p < pend; ++p) {
       to << ' ' << VARIABLE_DIMENSION;
       total_dimension *= VARIABLE_DIMENSION;
     }
@@ -365,35 +512,41 @@ void PathwayTab::printDaiFactorSection(ostream& to) {
 }
 
 void PathwayTab::splitNodeParents(const Node& n, const size_t maxParents) {
-  map< Node, map< Node, string > >::iterator pmap_i = _parents.find(n);
-  assert(pmap_i != _parents.end());
-  unsigned int numNodes = (pmap_i->second.size() / maxParents)
-    + (pmap_i->second.size() % maxParents > 0);
+  splitNodeParents(getNodeIndex(n), maxParents);
+}
+
+void PathwayTab::splitNodeParents(size_t n, const size_t maxParents) {
+  unsigned int numNodes = (_parents[n].size() / maxParents)
+    + (_parents[n].size() % maxParents > 0);
   if (numNodes > maxParents) {numNodes = maxParents;}
   if (numNodes > 1) {
-    vector<Node> newNodes;
+    vector< size_t > newNodes;
 
     // Step 1 of 4: create intermediate nodes
     for (size_t i = 0; i < numNodes; ++i) {
       stringstream s;
-      s << n.first << "__" << i;
-      Node newNode(s.str(), "active");
+      s << _symbols.name(_nodes[n].first) << "__" << i;
+      Symbol newEntity = _symbols.intern(s.str());
 
-      newNodes.push_back(newNode);
-      addEntity(newNode.first, "node_split");
+      addEntity(newEntity, _symbols.intern("node_split"));
+      newNodes.push_back(addNode(newEntity, _active));
     }
 
     // Step 2 of 4: connect parents to intermediate nodes
-    map< Node, string >::iterator parent_i = pmap_i->second.begin();
-    for (int nodeIndex = 0; parent_i != pmap_i->second.end(); ++parent_i) {
-      addEdge(parent_i->first, newNodes[nodeIndex], parent_i->second);
+    vector< Edge > parents = _parents[n];
+    sortByNode(parents);
+    vector< Edge >::iterator parent_i = parents.begin();
+    for (int nodeIndex = 0; parent_i != parents.end(); ++parent_i) {
+      addEdge(parent_i->parent, newNodes[nodeIndex], parent_i->label);
       nodeIndex = (nodeIndex + 1) % numNodes;
     }
 
     // Step 3 of 4: remove edges to child and replace with intermediate edges
-    _parents[n].clear();
+    clearParents(n);
     for (size_t i = 0; i < numNodes; ++i) {
-      addEdge(newNodes[i], n, _parents[newNodes[i]].begin()->second);
+      vector< Edge > firstParent = _parents[newNodes[i]];
+      sortByNode(firstParent);
+      addEdge(newNodes[i], n, firstParent.begin()->label);
     }
 
     // Step 4 of 4: recursively break up nodes, if necessary
@@ -404,27 +557,60 @@ void PathwayTab::splitNodeParents(const Node& n, const size_t maxParents) {
 }
 
 void PathwayTab::splitHighInDegree(const int maxParents) {
-  vector< Node > origN = _nodevector;
-  for (vector<Node>::iterator i = origN.begin(); i != origN.end(); ++i) {
-    splitNodeParents(*i, maxParents);
+  size_t origN = _nodes.size();
+  for (size_t i = 0; i < origN; ++i) {
+    splitNodeParents(i, maxParents);
   }
 }
-void PathwayTab::generateFactorValues(const Node& child,
+void PathwayTab::freeze() {
+  _childOrder = sortedNodes();
+  vector< size_t > rank(_nodes.size());
+  for (size_t i = 0; i < _childOrder.size(); ++i) {
+    rank[_childOrder[i]] = i;
+  }
+
+  _parentOffsets.assign(_nodes.size() + 1, 0);
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    _parentOffsets[i + 1] = _parentOffsets[i] + _parents[i].size();
+  }
+  _parentIndex.resize(_parentOffsets.back());
+  _parentLabel.resize(_parentOffsets.back());
+  _edgeLabels.clear();
+
+  unordered_map< Symbol, EdgeLabel > codes;
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    vector< Edge > parents = _parents[i];
+    sort(parents.begin(), parents.end(), [&rank](const Edge& a, const Edge& b) {
+	return rank[a.parent] < rank[b.parent];
+      });
+    for (size_t j = 0; j < parents.size(); ++j) {
+      pair< unordered_map< Symbol, EdgeLabel >::iterator, bool > ins;
+      ins = codes.insert(make_pair(parents[j].label, _edgeLabels.size()));
+      if (ins.second) {
+	if (_edgeLabels.size() > numeric_limits< EdgeLabel >::max()) {
+	  THROW("Too many distinct edge labels in pathway");
+	}
+	_edgeLabels.push_back(parents[j].label);
+      }
+      _parentIndex[_parentOffsets[i] + j] = parents[j].parent;
+      _parentLabel[_parentOffsets[i] + j] = ins.first->second;
+    }
+  }
+  _frozen = true;
+}
+
+void PathwayTab::generateFactorValues(size_t child,
 				      const vector< string >& edge_types,
 				      vector< Real >& outValues) const {
-  /// \todo make this polymorphic based on the entity type and node sub-type
-  map< string, string >::const_iterator entity_type_i;
-  entity_type_i = _entities.find(child.first);
-  if (entity_type_i == _entities.end()) {
+  Symbol entity_type = entityType(_nodes[child].first);
+  if (entity_type == SymbolTable::NONE) {
     THROW("Could not find entity in generateFactorValues");
   }
-  const string& entity_type = entity_type_i->second;
-  pair<string, string> lookup(entity_type, child.second);
-  map< pair<string, string>, FactorGenerator* >::const_iterator fgen_lookup;
+  unsigned long long lookup = packKey(entity_type, _nodes[child].second);
+  unordered_map< unsigned long long, shared_ptr< const FactorGenerator > >::const_iterator fgen_lookup;
   fgen_lookup = _factorGenLookup.find(lookup);
   if (fgen_lookup != _factorGenLookup.end()) {
-    FactorGenerator* f = fgen_lookup->second;
-    f->generateValues(edge_types, outValues);
+    fgen_lookup->second->generateValues(edge_types, outValues);
   } else {
     _defaultFactorGen->generateValues(edge_types, outValues);
   }
@@ -443,36 +629,42 @@ PathwayTab::constructFactors(const RunConfiguration::EMSteps& sp,
     sp_total_dim[i] = vector< size_t >(sp[i].size());
   }
 
-  map< Node,map< Node,string > >::const_iterator child_iter = _parents.begin();
-  for ( ; child_iter != _parents.end(); ++child_iter) {
-    const Node& child_node = child_iter->first;
-    const map< Node, string >& pmap = child_iter->second;
+  checkFrozen();
+  vector< size_t >::const_iterator child_iter = _childOrder.begin();
+  for ( ; child_iter != _childOrder.end(); ++child_iter) {
+    const size_t child_node = *child_iter;
+    const size_t pbegin = _parentOffsets[child_node];
+    const size_t pend = _parentOffsets[child_node + 1];
 
-    if (pmap.size() == 0) {
+    if (pbegin == pend) {
       continue;
     }
 
     vector< Var > factor_vars;
-    factor_vars.reserve(pmap.size() + 1);
-    Var child_var(Var(getNodeIndex(child_node), VARIABLE_DIMENSION));
+    factor_vars.reserve(pend - pbegin + 1);
+    Var child_var(Var(child_node, VARIABLE_DIMENSION));
     factor_vars.push_back(child_var);
 
     vector< string > edge_types;
-    edge_types.reserve(pmap.size());
+    edge_types.reserve(pend - pbegin);
     size_t total_dimension = VARIABLE_DIMENSION;
-    map< Node, string >::const_iterator p_iter = pmap.begin();
-    for ( ; p_iter != pmap.end(); ++p_iter) {
-      const Node& parent_node = p_iter->first;
-      const string& edge_type = p_iter->second;
-      Var parent_var(getNodeIndex(parent_node), VARIABLE_DIMENSION);
+    for (size_t p = pbegin; p < pend; ++p) {
+      Var parent_var(_parentIndex[p], VARIABLE_DIMENSION);
       factor_vars.push_back(parent_var);
-      edge_types.push_back(edge_type);
+      edge_types.push_back(_symbols.name(_edgeLabels[_parentLabel[p]]));
       total_dimension *= VARIABLE_DIMENSION;
     }
 
     vector< Real > factor_vals;
-    factor_vals.reserve(total_dimension);
-    generateFactorValues(child_node, edge_types, factor_vals);
+    if (child_node < _compiledNodes
+	&& (_compiledOffsets[child_node + 1] - _compiledOffsets[child_node]
+	    == total_dimension)) {
+      factor_vals.assign(_compiledValues + _compiledOffsets[child_node],
+			 _compiledValues + _compiledOffsets[child_node + 1]);
+    } else {
+      factor_vals.reserve(total_dimension);
+      generateFactorValues(child_node, edge_types, factor_vals);
+    }
     assert(factor_vals.size() == total_dimension);
 
     Factor f(factor_vars, factor_vals);
@@ -484,7 +676,7 @@ PathwayTab::constructFactors(const RunConfiguration::EMSteps& sp,
 	SmallSet< string > eset(edge_types.begin(), edge_types.end(),
 				edge_types.size());
 	const string& spec_subtype = jit->first;
-	const string& node_subtype = child_node.second;
+	const string& node_subtype = _symbols.name(_nodes[child_node].second);
 	if (spec_subtype == node_subtype
 	    && edge_types.size() == eset.size()
 	    && jit->second == eset) {
@@ -508,6 +700,15 @@ PathwayTab::constructFactors(const RunConfiguration::EMSteps& sp,
     }
   }
 
+  if (_props.hasKey("compress_chains")) {
+    string compress = _props.getStringAs<string>("compress_chains");
+    if (compress == "true") {
+      compressChains(outFactors, var_orders);
+    } else if (compress != "false") {
+      THROW("The 'compress_chains' option must be 'true' or 'false'");
+    }
+  }
+
   // Construct all Msteps
   for (size_t i= 0; i < var_orders.size(); ++i) {
     vector< SharedParameters> spvec;
@@ -528,7 +729,12 @@ PathwayTab::constructFactors(const RunConfiguration::EMSteps& sp,
       props.set("total_dim", sp_total_dim[i][j]);
       props.set("target_dim", VARIABLE_DIMENSION);
       ParameterEstimation* pe;
-      pe = ParameterEstimation::construct("CondProbEstimation", props);
+      {
+	// libDAI fills its estimator registry on first use, without locking
+	static mutex registry_lock;
+	lock_guard< mutex > lock(registry_lock);
+	pe = ParameterEstimation::construct("CondProbEstimation", props);
+      }
       spvec.push_back(SharedParameters(var_orders[i][j], pe, 1));
     }
     if (spvec.size() > 0) {
@@ -541,36 +747,156 @@ PathwayTab::constructFactors(const RunConfiguration::EMSteps& sp,
   return var_orders;
 }
 
+/// Eliminates hidden variables that lie on unbranched chains, such as the
+/// genome -> mRNA -> protein steps of an unmeasured gene.  A variable is
+/// summed out when it is not an output (active) node, is neither observed
+/// nor carries an observation, and appears in at most two factors that EM
+/// does not learn.  Its factors are replaced by their product marginalized
+/// over it, which leaves the distribution of the remaining variables as it
+/// was, so exact methods such as JTREE give the same marginals; loopy
+/// methods such as BP or MF run on a different graph and their
+/// approximations can change.  var_orders is renumbered to match the
+/// shorter factor list.
+void PathwayTab::compressChains(vector< Factor >& factors,
+				vector< vector < SharedParameters::FactorOrientations > >&
+				var_orders) const {
+  Symbol obs = _symbols.find(OBSERVATION_INTERACTION);
+  vector< bool > keep(_nodes.size(), false);
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    if (_nodes[i].second == _active) {
+      keep[i] = true;
+    }
+    for (size_t p = _parentOffsets[i]; p < _parentOffsets[i + 1]; ++p) {
+      if (_edgeLabels[_parentLabel[p]] == obs) {
+	keep[i] = true;
+	keep[_parentIndex[p]] = true;
+      }
+    }
+  }
+
+  vector< bool > locked(factors.size(), false);
+  for (size_t i = 0; i < var_orders.size(); ++i) {
+    for (size_t j = 0; j < var_orders[i].size(); ++j) {
+      SharedParameters::FactorOrientations::const_iterator fo;
+      for (fo = var_orders[i][j].begin(); fo != var_orders[i][j].end(); ++fo) {
+	locked[fo->first] = true;
+      }
+    }
+  }
+
+  vector< vector< size_t > > varFactors(_nodes.size());
+  for (size_t I = 0; I < factors.size(); ++I) {
+    const VarSet& vs = factors[I].vars();
+    for (VarSet::const_iterator v = vs.begin(); v != vs.end(); ++v) {
+      varFactors[v->label()].push_back(I);
+      keep[v->label()] = keep[v->label()] || locked[I];
+    }
+  }
+
+  vector< size_t > queue;
+  for (size_t v = 0; v < _nodes.size(); ++v) {
+    queue.push_back(v);
+  }
+  vector< bool > dead(factors.size(), false);
+  while (!queue.empty()) {
+    size_t v = queue.back();
+    queue.pop_back();
+    vector< size_t >& fs = varFactors[v];
+    if (keep[v] || fs.size() == 0 || fs.size() > 2) {
+      continue;
+    }
+
+    size_t target = fs[0];
+    Factor product = factors[target];
+    size_t width = product.vars().size();
+    if (fs.size() == 2) {
+      target = min(fs[0], fs[1]);
+      product = product * factors[fs[1]];
+      width = max(width, factors[fs[1]].vars().size());
+    }
+    VarSet rest = product.vars() / VarSet(Var(v, VARIABLE_DIMENSION));
+    if (rest.size() == 0 || rest.size() > width) {
+      continue;
+    }
+
+    if (fs.size() == 2) {
+      size_t other = max(fs[0], fs[1]);
+      const VarSet& ovs = factors[other].vars();
+      for (VarSet::const_iterator u = ovs.begin(); u != ovs.end(); ++u) {
+	vector< size_t >& ufs = varFactors[u->label()];
+	ufs.erase(find(ufs.begin(), ufs.end(), other));
+	if (find(ufs.begin(), ufs.end(), target) == ufs.end()) {
+	  ufs.push_back(target);
+	}
+      }
+      dead[other] = true;
+    }
+    factors[target] = product.marginal(rest, false);
+    fs.clear();
+
+    for (VarSet::const_iterator u = rest.begin(); u != rest.end(); ++u) {
+      queue.push_back(u->label());
+    }
+  }
+
+  vector< size_t > renumber(factors.size());
+  size_t live = 0;
+  for (size_t I = 0; I < factors.size(); ++I) {
+    if (!dead[I]) {
+      renumber[I] = live;
+      if (live != I) {
+	factors[live] = factors[I];
+      }
+      ++live;
+    }
+  }
+  if (VERBOSE) {
+    cerr << "Compressed " << factors.size() << " factors into " << live << endl;
+  }
+  factors.resize(live);
+
+  for (size_t i = 0; i < var_orders.size(); ++i) {
+    for (size_t j = 0; j < var_orders[i].size(); ++j) {
+      SharedParameters::FactorOrientations renumbered;
+      SharedParameters::FactorOrientations::const_iterator fo;
+      for (fo = var_orders[i][j].begin(); fo != var_orders[i][j].end(); ++fo) {
+	renumbered[renumber[fo->first]] = fo->second;
+      }
+      var_orders[i][j] = renumbered;
+    }
+  }
+}
+
 map< long, string > PathwayTab::getOutputNodeMap() {
   map< long, string > result;
-  for (size_t i = 0; i < _nodevector.size(); ++i) {
-    if (_nodevector[i].second == "active") {
-      result[i] = _nodevector[i].first;
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    if (_nodes[i].second == _active) {
+      result[i] = _symbols.name(_nodes[i].first);
     }
   }
   return result;
 }
 
 void PathwayTab::dumpNodeIndexMap() const {
-  map< Node, size_t>::const_iterator i = _nodemap.begin();
-  for( ; i != _nodemap.end(); ++i) {
-    const Node& n = i->first;
-    size_t idx = i->second;
-    const Node& nv = _nodevector[idx];
+  vector< size_t > order = sortedNodes();
+  for (size_t i = 0; i < order.size(); ++i) {
+    size_t idx = order[i];
+    Node n = getNode(idx);
     cerr << idx << '\t'
 	 << n.first << '\t' << n.second << '\t'
-	 << nv.first << '\t' << nv.second << endl;
+	 << getNodeIndex(n) << endl;
   }
 }
 
 
 int PathwayTab::debugPrintParents(size_t node_i) {
-  Node c = _nodevector[node_i];
-  if (_parents.count(c) > 0) {
-    map<Node, string>::iterator i = _parents[c].begin();
-    for (; i != _parents[c].end(); ++i) {
-      cout << _nodemap[i->first] << '\t' << i->first.first << "\t" << i->first.second << '\t' << i->second <<endl;
-    }
+  vector< Edge > parents = _parents[node_i];
+  sortByNode(parents);
+  vector< Edge >::iterator i = parents.begin();
+  for (; i != parents.end(); ++i) {
+    Node p = getNode(i->parent);
+    cout << i->parent << '\t' << p.first << "\t" << p.second << '\t'
+	 << _symbols.name(i->label) <<endl;
   }
   return -1;
 }
@@ -12,6 +12,8 @@
 #include <iostream>
 #include <set>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <sstream>
 
@@ -21,6 +23,7 @@
 #include <dai/emalg.h>
 
 #include "configuration.h"
+#include "symboltable.h"
 
 using namespace std;
 using namespace dai;
@@ -66,6 +69,7 @@ public:
 };
 
 class PathwayTab;
+class MappedFile;
 
 void readInteractionMap(istream& is, map< string, vector< string > >& out_imap);
 
@@ -73,14 +77,19 @@ class GeneProteinExpressionModel {
 private:
   set< string > _states;
   set< string > _steps;
+  void read(const string& dogma);
 public:
   GeneProteinExpressionModel(istream& is);
-  void addGeneDogma(const string& genename, PathwayTab& pathway_graph);
+  GeneProteinExpressionModel(const string& dogma);
+  void addGeneDogma(SymbolTable::Symbol gene, PathwayTab& pathway_graph);
 };
 
 class PathwayTab {
+  friend class PathwayCache;
 public:
   typedef pair< string, string > Node;
+  typedef SymbolTable::Symbol Symbol;
+  typedef unsigned char EdgeLabel;
 
   static const size_t VARIABLE_DIMENSION; // = 3
   static const std::string DEFAULT_INTERACTION_MAP;
@@ -89,85 +98,160 @@ public:
 private:
   static const string OBSERVATION_INTERACTION;
 
-  map< Node, size_t > _nodemap;
-  vector< Node > _nodevector;
-  map< Node, map< Node, string > > _parents;
-  map< string, string > _entities;
+  /// An incoming edge of a node: the parent node index and the edge label
+  struct Edge {
+    size_t parent;
+    Symbol label;
+    Edge(size_t p, Symbol l) : parent(p), label(l) {}
+  };
+
+  /// An interaction map entry, with the node sub-types and the edge label
+  struct Interaction {
+    Symbol from_type;
+    Symbol to_type;
+    Symbol label;
+  };
+
+  static unsigned long long packKey(size_t a, size_t b) {
+    return ((unsigned long long)a << 32) | b;
+  }
+
+  /// Entity names, node sub-types, entity types and edge labels
+  SymbolTable _symbols;
+  Symbol _active;
+  Symbol _protein;
+
+  unordered_map< unsigned long long, size_t > _nodemap; // (entity, sub-type)
+  vector< pair< Symbol, Symbol > > _nodes;
+  vector< vector< Edge > > _parents;
+  unordered_map< unsigned long long, size_t > _edgemap; // (child, parent)
+  vector< Symbol > _entityTypes; // NONE for symbols that are not entities
+
+  /// Compressed sparse row copy of _parents, rebuilt by freeze(). The
+  /// parents of node i are _parentIndex[_parentOffsets[i]] up to
+  /// _parentIndex[_parentOffsets[i+1]], sorted like _childOrder.
+  bool _frozen;
+  vector< size_t > _childOrder;
+  vector< size_t > _parentOffsets;
+  vector< unsigned int > _parentIndex;
+  vector< EdgeLabel > _parentLabel;
+  vector< Symbol > _edgeLabels; // EdgeLabel -> label symbol
   GeneProteinExpressionModel _dogma;
-  map< string, vector< string > > _imap;
+  unordered_map< Symbol, Interaction > _imap;
 
   PropertySet _props;
-  map< pair<string, string>, FactorGenerator* > _factorGenLookup;
-  FactorGenerator* _defaultFactorGen;
+  /// Generators are immutable once registered, so they may be shared
+  /// between pathways built on different threads
+  unordered_map< unsigned long long, shared_ptr< const FactorGenerator > > _factorGenLookup;
+  shared_ptr< const FactorGenerator > _defaultFactorGen;
 
-  PathwayTab(istream& pathway_stream,
+  /// Factor tables of the pathway nodes when loaded from a compiled
+  /// cache: node i uses _compiledValues[_compiledOffsets[i]] up to
+  /// _compiledValues[_compiledOffsets[i+1]], which point into _compiled
+  shared_ptr< const MappedFile > _compiled;
+  size_t _compiledNodes;
+  const unsigned long long* _compiledOffsets;
+  const Real* _compiledValues;
+
+  PathwayTab(const GeneProteinExpressionModel& dogma,
+	     const PropertySet& props);
+  PathwayTab(const char* pathway_begin,
+	     const char* pathway_end,
 	     istream& imap_stream,
 	     istream& dogma_stream,
 	     const PropertySet& props);
+  PathwayTab(shared_ptr< const MappedFile > compiled,
+	     const PropertySet& props);
+  void initialize(istream& imap_stream);
+
+  Symbol entityType(Symbol entity) const {
+    return entity < _entityTypes.size() ? _entityTypes[entity]
+      : SymbolTable::NONE;
+  }
+  bool nodeLess(size_t a, size_t b) const;
+  void sortByNode(vector< Edge >& edges) const;
+  vector< size_t > sortedNodes() const;
+
+  void addEdge(size_t from, size_t to, Symbol label);
+  void clearParents(size_t node);
+  pair< Symbol, Symbol > getAppropriateEntityNode(Symbol entity,
+						  Symbol species) const;
+  void splitNodeParents(size_t node, const size_t maxParents);
+  void checkFrozen() const {
+    if (!_frozen) {
+      THROW("PathwayTab must be frozen after its last modification");
+    }
+  }
+  void generateFactorValues(size_t child,
+			    const vector< string >& edge_types,
+			    vector< Real >& outValues) const;
+  void compressChains(vector< Factor >& factors,
+		      vector< vector < SharedParameters::FactorOrientations > >&
+		      var_orders) const;
+
 public:
   static PathwayTab create(istream& pathway_stream,
 			   const PropertySet& props,
 			   istream* imap_stream=NULL,
-			   istream* dogma_stream=NULL) {
-    istringstream is(DEFAULT_INTERACTION_MAP);
-    istringstream ds(CENTRAL_DOGMA);
-    if (imap_stream == NULL) {
-      imap_stream = &is;
-    }
-    if (dogma_stream == NULL) {
-      dogma_stream = &ds;
-    }
-    return PathwayTab(pathway_stream, *imap_stream, *dogma_stream, props);
-  }
+			   istream* dogma_stream=NULL);
 
-  ~PathwayTab() {
-    delete _defaultFactorGen;
-    map< pair<string, string>, FactorGenerator* >::iterator i;
-    i= _factorGenLookup.begin();
-    for ( ; i != _factorGenLookup.end(); ++i) {
-      delete i->second;
-    }
+  /// Maps \a pathway_filename and parses it in place, with the default
+  /// interaction map and dogma; .gz and .zst files are decompressed first
+  static PathwayTab create(const string& pathway_filename,
+			   const PropertySet& props);
+
+  /// Loads a pathway compiled by PathwayCache::write
+  static PathwayTab create(shared_ptr< const MappedFile > compiled,
+			   const PropertySet& props) {
+    return PathwayTab(compiled, props);
   }
 
+  /// Move-only, as copying would deep-copy every node and edge table
+  PathwayTab(const PathwayTab& x) = delete;
+  PathwayTab& operator=(const PathwayTab& x) = delete;
+  PathwayTab(PathwayTab&& x) = default;
+  PathwayTab& operator=(PathwayTab&& x) = default;
+
+  Symbol intern(std::string_view s) { return _symbols.intern(s); }
+
+  void addEntity(Symbol entity, Symbol type);
+  void addInteraction(Symbol entity_from, Symbol entity_to,
+		      Symbol interaction);
   void addEntity(const string& entity, const string& type="protein");
   Var addObservationNode(const string& entity, const string& on_type,
 			 const string& obstype);
   void addInteraction(const string& entity_from, const string& entity_to,
 		      const string& interaction);
 
+  size_t addNode(Symbol entity, Symbol sub_type);
   void addNode(Node nodename); // see also addEntity
   void addEdge(const Node& from, const Node& to, const string& label);
-  void getAppropriateEntityNode(const string& entity, const string& species,
-				Node& out_node);
-  Node getNode(size_t i) const { return _nodevector[i]; }
-
-  size_t getNodeIndex(const Node& n) const {
-    map< Node, size_t >::const_iterator i = _nodemap.find(n);
-    return i->second;
+  Node getNode(size_t i) const {
+    return Node(_symbols.name(_nodes[i].first),
+		_symbols.name(_nodes[i].second));
   }
-  string getEntityType(const string& entity) {
-	return _entities[entity];
+  size_t nrNodes() const { return _nodes.size(); }
+
+  size_t getNodeIndex(const Node& n) const;
+  string getEntityType(const string& entity) const {
+    Symbol t = entityType(_symbols.find(entity));
+    return t == SymbolTable::NONE ? string() : _symbols.name(t);
   }
 
   void dumpNodeIndexMap() const;
 
   string getInteraction(size_t child_i, size_t parent_i) const {
-    Node c = getNode(child_i);
-    Node p = getNode(parent_i);
-    string result = "";
-    map< Node, map< Node, string > >::const_iterator ci = _parents.find(c);
-    if (ci != _parents.end()) {
-      map< Node, string >::const_iterator pi = ci->second.find(p);
-      if (pi != ci->second.end()) {
-	result = pi->second;
-      }
+    unordered_map< unsigned long long, size_t >::const_iterator i;
+    i = _edgemap.find(packKey(child_i, parent_i));
+    if (i == _edgemap.end()) {
+      return "";
     }
-    return result;
+    return _symbols.name(_parents[child_i][i->second].label);
   }
 
   void addFactorGenerator(const string& entity_type,
 			  const string& node_type,
-			  FactorGenerator* factor_gen);
+			  shared_ptr< const FactorGenerator > factor_gen);
 
   int debugPrintParents(size_t node_i);
   void printNodeMap(ostream& to=cout, const string& prefix="# ");
@@ -176,9 +260,10 @@ public:
   void splitNodeParents(const Node& n, const size_t maxParents);
   void splitHighInDegree(const int maxParents);
 
-  void generateFactorValues(const Node& child,
-			    const vector< string >& edge_types,
-			    vector< Real >& outValues) const;
+  /// Builds the compact parent graph used by constructFactors and
+  /// printDaiFactorSection; call again after adding nodes or edges
+  void freeze();
+
   vector< vector < SharedParameters::FactorOrientations > >
   constructFactors(const RunConfiguration::EMSteps& sp,
 			vector< Factor >& outFactors,
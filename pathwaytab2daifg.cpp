@@ -7,8 +7,10 @@
 /********************************************************************************/
 
 #include <fstream>
+#include <cstdlib>
+#include <unistd.h>
 
-#include "pathwaytab.h"
+#include "pathwaycompiler.h"
 
 void usage(int exit_code) {
   cout << "pathwaytab2daifg"
@@ -17,18 +19,63 @@ void usage(int exit_code) {
 #endif
        << endl
        << "Usage: " << endl
-       << "  pathwaytab2daifg pathway_file [config_file]"<< endl;
+       << "  pathwaytab2daifg pathway_file [config_file]"<< endl
+       << "  pathwaytab2daifg -b [-t threads] [-c config_file] pathway_file..."
+       << endl
+       << "  pathwaytab2daifg -w [-t threads] [-c config_file] pathway_file..."
+       << endl
+       << "The second form builds the factor graphs on several threads and"
+       << " prints" << endl
+       << "them in order; the third only compiles each pathway to"
+       << " pathway_file.pwb." << endl
+       << "-t and -c are only accepted with -b or -w." << endl;
   exit(exit_code);
 }
 
 int main(int argc, char** argv) {
-  if (argc != 2 && argc != 3) {
+  bool batch = false;
+  bool compile = false;
+  size_t threads = 1;
+  string config_file = "/dev/null";
+  int opt;
+  while ((opt = getopt(argc, argv, "hbwt:c:")) != -1) {
+    switch (opt) {
+    case 'b': batch = true; break;
+    case 'w': compile = true; break;
+    case 't': threads = strtoul(optarg, NULL, 10); break;
+    case 'c': config_file = optarg; break;
+    case 'h': usage(0); break;
+    default: usage(2);
+    }
+  }
+
+  if (batch || compile) {
+    if (optind == argc) {
+      usage(2);
+    }
+    RunConfiguration c(config_file);
+    vector< string > files(argv + optind, argv + argc);
+    ThreadPool pool(threads == 0 ? 1 : threads);
+    if (compile) {
+      compilePathwayCaches(files, c.pathwayProps(), pool);
+      return 0;
+    }
+    vector< unique_ptr< CompiledPathway > > compiled
+      = compilePathways(files, c, pool);
+    for (size_t i = 0; i < compiled.size(); ++i) {
+      cout << "# " << compiled[i]->filename << endl;
+      compiled[i]->pathway.printNodeMap();
+      cout << compiled[i]->graph;
+    }
+    return 0;
+  }
+
+  if (optind != 1 || (argc != 2 && argc != 3)) {
     usage(2);
   }
 
-  ifstream path_stream(argv[1]);
   RunConfiguration c(argc == 3 ? argv[2] : "/dev/null");
-  PathwayTab path = PathwayTab::create(path_stream, c.pathwayProps());
+  PathwayTab path = PathwayTab::create(string(argv[1]), c.pathwayProps());
 
   vector< Factor > factors;
   vector< MaximizationStep > msteps;
@@ -0,0 +1,192 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "perturbationmatrix.h"
+#include "perturbationmatrixwriter.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+namespace {
+
+const char MAGIC[8] = { 'P', 'D', 'G', 'M', 'P', 'T', 'B', '\0' };
+const unsigned int FORMAT_VERSION = 1;
+
+}
+
+const std::string PerturbationMatrix::EXTENSION = ".ptb";
+
+struct PerturbationMatrix::Header {
+  char magic[8];
+  unsigned int version;
+  unsigned int reserved;
+  unsigned long long nodes;
+  unsigned long long samples;
+  unsigned long long node_bytes;
+  unsigned long long sample_bytes;
+};
+
+namespace {
+
+size_t scoreBytes(const PerturbationMatrix::Header& h) {
+  return h.samples * h.nodes * sizeof(float);
+}
+
+/// Sections in file order: the node table, the scores, then the sample
+/// table, which is only known once every row has been written
+size_t layoutSize(const PerturbationMatrix::Header& h) {
+  size_t n = alignSection(sizeof(PerturbationMatrix::Header));
+  n += alignSection((h.nodes + 1) * sizeof(unsigned long long));
+  n += alignSection(h.node_bytes);
+  n += alignSection(scoreBytes(h));
+  n += alignSection(h.samples * sizeof(double));
+  n += alignSection((h.samples + 1) * sizeof(unsigned long long));
+  n += alignSection(h.sample_bytes);
+  return n;
+}
+
+/// True if no count is larger than the file, so layoutSize can not
+/// overflow
+bool countsFit(const PerturbationMatrix::Header& h, size_t size) {
+  return h.nodes <= size && h.samples <= size && h.node_bytes <= size
+    && h.sample_bytes <= size
+    && (h.nodes == 0 || h.samples <= size / h.nodes);
+}
+
+}
+
+PerturbationMatrix::PerturbationMatrix(const std::string& filename,
+				       MappedFile::Access access)
+  : _file(filename, access),
+    _header(reinterpret_cast< const Header* >(_file.data())),
+    _nodeOffsets(NULL),
+    _nodeNames(NULL),
+    _scores(NULL),
+    _loglikelihoods(NULL),
+    _sampleOffsets(NULL),
+    _sampleNames(NULL)
+{
+  if (_file.size() < sizeof(Header)
+      || memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0
+      || _header->version != FORMAT_VERSION
+      || !countsFit(*_header, _file.size())
+      || _file.size() != layoutSize(*_header)) {
+    THROW("Not a valid perturbation matrix: " + filename);
+  }
+  SectionReader r(_file.data());
+  r.take< Header >(1);
+  _nodeOffsets = r.take< unsigned long long >(_header->nodes + 1);
+  _nodeNames = r.take< char >(_header->node_bytes);
+  _scores = r.take< float >(_header->samples * _header->nodes);
+  _loglikelihoods = r.take< double >(_header->samples);
+  _sampleOffsets = r.take< unsigned long long >(_header->samples + 1);
+  _sampleNames = r.take< char >(_header->sample_bytes);
+
+  if (!validOffsets(_nodeOffsets, _header->nodes, _header->node_bytes)
+      || !validOffsets(_sampleOffsets, _header->samples,
+		       _header->sample_bytes)) {
+    THROW("Not a valid perturbation matrix: " + filename);
+  }
+}
+
+bool PerturbationMatrix::isMatrix(const std::string& filename)
+{
+  char magic[sizeof(MAGIC)];
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  return in.read(magic, sizeof(magic))
+    && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+size_t PerturbationMatrix::nodes() const
+{
+  return _header->nodes;
+}
+
+size_t PerturbationMatrix::samples() const
+{
+  return _header->samples;
+}
+
+size_t PerturbationMatrix::rowAt(unsigned long long offset) const
+{
+  size_t first = reinterpret_cast< const char* >(_scores) - _file.data();
+  size_t bytes = nodes() * sizeof(float);
+  if (offset < first || bytes == 0 || (offset - first) % bytes != 0
+      || (offset - first) / bytes >= samples()) {
+    return samples();
+  }
+  return (offset - first) / bytes;
+}
+
+PerturbationMatrixWriter::PerturbationMatrixWriter(const string& filename)
+  : _file(filename),
+    _nodes(0),
+    _row(),
+    _loglikelihoods(),
+    _sampleOffsets(1, 0),
+    _sampleNames(),
+    _nodeOffsets(1, 0),
+    _nodeNames()
+{
+}
+
+void PerturbationMatrixWriter::begin(const vector< string >& nodes)
+{
+  _nodes = nodes.size();
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    _nodeNames += nodes[i];
+    _nodeOffsets.push_back(_nodeNames.size());
+  }
+  // the header is written again by finish(), once the samples are known
+  PerturbationMatrix::Header h;
+  memset(&h, 0, sizeof(h));
+  SectionWriter w(_file.stream());
+  w.put(&h, 1);
+  w.put(_nodeOffsets);
+  w.put(_nodeNames.data(), _nodeNames.size());
+}
+
+void PerturbationMatrixWriter::write(const string& sample,
+				     double loglikelihood,
+				     const vector< double >& scores)
+{
+  _row.assign(scores.begin(), scores.end());
+  indexed(sample, _file.stream().tellp(), _row.size() * sizeof(float));
+  _file.stream().write(reinterpret_cast< const char* >(_row.data()),
+		       _row.size() * sizeof(float));
+  _loglikelihoods.push_back(loglikelihood);
+  _sampleNames += sample;
+  _sampleOffsets.push_back(_sampleNames.size());
+}
+
+void PerturbationMatrixWriter::finish()
+{
+  PerturbationMatrix::Header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = FORMAT_VERSION;
+  h.nodes = _nodes;
+  h.samples = _loglikelihoods.size();
+  h.node_bytes = _nodeNames.size();
+  h.sample_bytes = _sampleNames.size();
+
+  static const char zeros[8] = { 0 };
+  _file.stream().write(zeros, alignSection(scoreBytes(h)) - scoreBytes(h));
+  SectionWriter w(_file.stream());
+  w.put(_loglikelihoods);
+  w.put(_sampleOffsets);
+  w.put(_sampleNames.data(), _sampleNames.size());
+  _file.stream().seekp(0);
+  w.put(&h, 1);
+  _file.commit();
+  flushIndex();
+}
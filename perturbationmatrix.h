@@ -0,0 +1,73 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_PERTURBATIONMATRIX_H
+#define HEADER_PERTURBATIONMATRIX_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mappedfile.h"
+
+/// The binary perturbation output of a run (output [format=binary]):
+/// node and sample name tables, a dense row-major float32 matrix of
+/// scores with a row per sample and NaN for NA, and the loglikelihood of
+/// each sample.  It is mapped read-only, so any row is one contiguous
+/// run of floats and any column a strided walk over the same pages.
+class PerturbationMatrix
+{
+public:
+  struct Header;
+  /// The conventional extension, which mergeswarmfiles looks for
+  static const std::string EXTENSION; // = ".ptb"
+
+private:
+  MappedFile _file;
+  const Header* _header;
+  const unsigned long long* _nodeOffsets;
+  const char* _nodeNames;
+  const float* _scores;
+  const double* _loglikelihoods;
+  const unsigned long long* _sampleOffsets;
+  const char* _sampleNames;
+
+public:
+  /// Maps \a filename, throwing if it is not a valid matrix.  Lookups
+  /// by sample are the common case; pass SEQUENTIAL to walk every row.
+  PerturbationMatrix(const std::string& filename,
+		     MappedFile::Access access = MappedFile::RANDOM);
+
+  /// Whether \a filename starts like a matrix, without mapping it
+  static bool isMatrix(const std::string& filename);
+
+  size_t nodes() const;
+  std::string_view node(size_t column) const {
+    return std::string_view(_nodeNames + _nodeOffsets[column],
+			    _nodeOffsets[column + 1] - _nodeOffsets[column]);
+  }
+  size_t samples() const;
+  std::string_view sample(size_t row) const {
+    return std::string_view(_sampleNames + _sampleOffsets[row],
+			    _sampleOffsets[row + 1] - _sampleOffsets[row]);
+  }
+
+  /// The nodes() scores of sample \a row
+  const float* row(size_t row) const { return _scores + row * nodes(); }
+  float score(size_t row, size_t column) const {
+    return _scores[row * nodes() + column];
+  }
+  double loglikelihood(size_t row) const { return _loglikelihoods[row]; }
+
+  /// The row at \a offset bytes into the file, as in a sample index, or
+  /// samples() if no row starts there
+  size_t rowAt(unsigned long long offset) const;
+};
+
+#endif
@@ -0,0 +1,43 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_PERTURBATIONMATRIXWRITER_H
+#define HEADER_PERTURBATIONMATRIXWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "binaryio.h"
+#include "perturbationwriter.h"
+
+/// Writes a PerturbationMatrix.  Rows are appended as samples arrive and
+/// the name tables and header are completed by finish(); the file only
+/// appears under its name once it is complete.  It is defined beside
+/// the reader in perturbationmatrix.cpp, which owns the layout.
+class PerturbationMatrixWriter : public PerturbationWriter
+{
+private:
+  AtomicOutputFile _file;
+  size_t _nodes;
+  vector< float > _row;
+  vector< double > _loglikelihoods;
+  vector< unsigned long long > _sampleOffsets;
+  string _sampleNames;
+  vector< unsigned long long > _nodeOffsets;
+  string _nodeNames;
+
+public:
+  PerturbationMatrixWriter(const string& filename);
+
+  void begin(const vector< string >& nodes);
+  void write(const string& sample, double loglikelihood,
+	     const vector< double >& scores);
+  void finish();
+};
+
+#endif
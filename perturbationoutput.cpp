@@ -0,0 +1,109 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "compressedio.h"
+#include "perturbationmatrixwriter.h"
+#include "perturbationoutput.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+namespace {
+
+double outputThreshold(const PropertySet& output_props)
+{
+  double threshold = 0;
+  if (output_props.hasKey("threshold")) {
+    threshold = output_props.getStringAs<double>("threshold");
+    if (!(threshold >= 0)) {
+      THROW("output [threshold=...] must not be negative");
+    }
+  }
+  return threshold;
+}
+
+}
+
+unique_ptr< PerturbationWriter >
+newPerturbationWriter(const PropertySet& output_props,
+		      const string& filename, bool index)
+{
+  string format = "fasta";
+  if (output_props.hasKey("format")) {
+    format = output_props.getAs<string>("format");
+  }
+  if (index && (format == "none" || filename == ""
+		|| compressionOf(filename) != UNCOMPRESSED)) {
+    THROW("A sample index needs an uncompressed -o file");
+  }
+
+  unique_ptr< PerturbationWriter > writer;
+  if (format == "binary") {
+    if (filename == "" || compressionOf(filename) != UNCOMPRESSED) {
+      THROW("output [format=binary] needs an uncompressed -o file");
+    }
+    writer.reset(new PerturbationMatrixWriter(filename));
+  } else if (format == "none") {
+    if (filename != "") {
+      THROW("output [format=none] writes no -o file");
+    }
+    writer.reset(new NullPerturbationWriter());
+  } else if (format == "fasta" || format == "sparse") {
+    unique_ptr< ostream > file;
+    if (filename != "") {
+      file = openOutput(filename);
+      if (!*file) {
+	THROW("couldn't open output file");
+      }
+    }
+    if (format == "sparse") {
+      double threshold = outputThreshold(output_props);
+      size_t top_k = SparsePerturbationWriter::ALL;
+      if (output_props.hasKey("top_k")) {
+	top_k = output_props.getStringAs<size_t>("top_k");
+      }
+      if (file) {
+	writer.reset(new SparsePerturbationWriter(std::move(file), threshold,
+						  top_k));
+      } else {
+	writer.reset(new SparsePerturbationWriter(cout, threshold, top_k));
+      }
+    } else if (file) {
+      writer.reset(new FastaPerturbationWriter(std::move(file)));
+    } else {
+      writer.reset(new FastaPerturbationWriter(cout));
+    }
+  } else {
+    THROW("Unknown output format " + format);
+  }
+
+  if (index) {
+    string index_filename = filename + PerturbationWriter::INDEX_EXTENSION;
+    unique_ptr< ostream > index_file(new ofstream(index_filename.c_str()));
+    if (!*index_file) {
+      THROW("couldn't open index file " + index_filename);
+    }
+    writer->indexTo(std::move(index_file));
+  }
+  return writer;
+}
+
+unique_ptr< PerturbationWriter >
+newSummaryWriter(const PropertySet& output_props, const string& filename)
+{
+  double threshold = outputThreshold(output_props);
+  unique_ptr< ostream > file = openOutput(filename);
+  if (!*file) {
+    THROW("couldn't open summary file");
+  }
+  return unique_ptr< PerturbationWriter >
+    (new SummaryPerturbationWriter(std::move(file), threshold));
+}
@@ -0,0 +1,36 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_PERTURBATIONOUTPUT_H
+#define HEADER_PERTURBATIONOUTPUT_H
+
+#include <memory>
+#include <string>
+#include <dai/properties.h>
+
+#include "perturbationwriter.h"
+
+using namespace dai;
+
+/// Creates the writer selected by the output [format=...] configuration
+/// block: fasta (the default), sparse (with optional threshold=x, default
+/// 0, and top_k=n), binary or none.  Text formats are written to
+/// \a filename, or standard output when it is empty; binary output needs
+/// a plain file name and none takes no file name.  With \a index, the
+/// sample index is written to filename.idx, which needs an uncompressed
+/// file in a format other than none.
+unique_ptr< PerturbationWriter >
+newPerturbationWriter(const PropertySet& output_props,
+		      const string& filename, bool index = false);
+
+/// A SummaryPerturbationWriter to \a filename, counting scores above the
+/// threshold=x of the output block (default 0)
+unique_ptr< PerturbationWriter >
+newSummaryWriter(const PropertySet& output_props, const string& filename);
+
+#endif
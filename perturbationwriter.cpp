@@ -0,0 +1,217 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "perturbationwriter.h"
+
+const std::string PerturbationWriter::INDEX_EXTENSION = ".idx";
+
+void PerturbationWriter::indexed(const string& sample,
+				 unsigned long long offset, size_t length)
+{
+  if (_index) {
+    _indexText << sample << '\t' << (size_t)offset << '\t' << length << '\n';
+    _indexText.writeTo(*_index);
+  }
+}
+
+FastaPerturbationWriter::FastaPerturbationWriter(ostream& out)
+  : _file(), _out(out), _nodes(), _text(), _offset(0)
+{
+}
+
+FastaPerturbationWriter::FastaPerturbationWriter(unique_ptr< ostream > file)
+  : _file(std::move(file)), _out(*_file), _nodes(), _text(),
+    _offset(0)
+{
+}
+
+void FastaPerturbationWriter::begin(const vector< string >& nodes)
+{
+  _nodes = nodes;
+}
+
+void FastaPerturbationWriter::write(const string& sample,
+				    double loglikelihood,
+				    const vector< double >& scores)
+{
+  _text << "> " << sample << " loglikelihood=" << loglikelihood << '\n';
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    _text << _nodes[i] << '\t';
+    if (std::isnan(scores[i])) {
+      _text << "NA";
+    } else {
+      _text << scores[i];
+    }
+    _text << '\n';
+  }
+  indexed(sample, _offset, _text.size());
+  writeBlock();
+}
+
+void FastaPerturbationWriter::writeBlock()
+{
+  _offset += _text.size();
+  _text.writeTo(_out);
+}
+
+void FastaPerturbationWriter::flush()
+{
+  _out.flush();
+  flushIndex();
+}
+
+void FastaPerturbationWriter::finish()
+{
+  _out.flush();
+  flushIndex();
+}
+
+SparsePerturbationWriter::SparsePerturbationWriter(ostream& out,
+						   double threshold,
+						   size_t top_k)
+  : FastaPerturbationWriter(out), _threshold(threshold), _topK(top_k),
+    _selected()
+{
+}
+
+SparsePerturbationWriter::SparsePerturbationWriter(unique_ptr< ostream > file,
+						   double threshold,
+						   size_t top_k)
+  : FastaPerturbationWriter(std::move(file)), _threshold(threshold),
+    _topK(top_k), _selected()
+{
+}
+
+void SparsePerturbationWriter::begin(const vector< string >& nodes)
+{
+  FastaPerturbationWriter::begin(nodes);
+  _text << "# format=sparse threshold=" << _threshold;
+  if (_topK != ALL) {
+    _text << " top_k=" << _topK;
+  }
+  _text << '\n';
+  writeBlock();
+}
+
+void SparsePerturbationWriter::write(const string& sample,
+				     double loglikelihood,
+				     const vector< double >& scores)
+{
+  _selected.clear();
+  for (size_t i = 0; i < scores.size(); ++i) {
+    // false for NaN
+    if (std::fabs(scores[i]) > _threshold) {
+      _selected.push_back(i);
+    }
+  }
+  if (_selected.size() > _topK) {
+    // largest first, ties to the earlier node so the choice is stable
+    nth_element(_selected.begin(), _selected.begin() + _topK, _selected.end(),
+		[&](size_t a, size_t b) {
+		  double sa = std::fabs(scores[a]);
+		  double sb = std::fabs(scores[b]);
+		  return sa > sb || (sa == sb && a < b);
+		});
+    _selected.resize(_topK);
+    sort(_selected.begin(), _selected.end());
+  }
+
+  _text << "> " << sample << " loglikelihood=" << loglikelihood << '\n';
+  for (size_t k = 0; k < _selected.size(); ++k) {
+    _text << _nodes[_selected[k]] << '\t' << scores[_selected[k]] << '\n';
+  }
+  indexed(sample, _offset, _text.size());
+  writeBlock();
+}
+
+SummaryPerturbationWriter::SummaryPerturbationWriter(unique_ptr< ostream > file,
+						     double threshold)
+  : _file(std::move(file)), _threshold(threshold), _text()
+{
+}
+
+void SummaryPerturbationWriter::begin(const vector< string >&)
+{
+  _text << "# threshold=" << _threshold << '\n'
+	<< "sample\tloglikelihood\tmean_abs_score\tabove_threshold\tNA\n";
+  _text.writeTo(*_file);
+}
+
+void SummaryPerturbationWriter::write(const string& sample,
+				      double loglikelihood,
+				      const vector< double >& scores)
+{
+  double total = 0;
+  size_t above = 0;
+  size_t na = 0;
+  for (size_t i = 0; i < scores.size(); ++i) {
+    if (std::isnan(scores[i])) {
+      ++na;
+      continue;
+    }
+    double a = std::fabs(scores[i]);
+    total += a;
+    above += a > _threshold;
+  }
+  _text << sample << '\t' << loglikelihood << '\t';
+  if (na == scores.size()) {
+    _text << "NA";
+  } else {
+    _text << total / (scores.size() - na);
+  }
+  _text << '\t' << above << '\t' << na << '\n';
+  _text.writeTo(*_file);
+}
+
+void SummaryPerturbationWriter::flush()
+{
+  _file->flush();
+}
+
+void SummaryPerturbationWriter::finish()
+{
+  _file->flush();
+}
+
+TeePerturbationWriter::TeePerturbationWriter
+(vector< unique_ptr< PerturbationWriter > > writers)
+  : _writers(std::move(writers))
+{
+}
+
+void TeePerturbationWriter::begin(const vector< string >& nodes)
+{
+  for (size_t i = 0; i < _writers.size(); ++i) {
+    _writers[i]->begin(nodes);
+  }
+}
+
+void TeePerturbationWriter::write(const string& sample, double loglikelihood,
+				  const vector< double >& scores)
+{
+  for (size_t i = 0; i < _writers.size(); ++i) {
+    _writers[i]->write(sample, loglikelihood, scores);
+  }
+}
+
+void TeePerturbationWriter::flush()
+{
+  for (size_t i = 0; i < _writers.size(); ++i) {
+    _writers[i]->flush();
+  }
+}
+
+void TeePerturbationWriter::finish()
+{
+  for (size_t i = 0; i < _writers.size(); ++i) {
+    _writers[i]->finish();
+  }
+}
@@ -0,0 +1,166 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_PERTURBATIONWRITER_H
+#define HEADER_PERTURBATIONWRITER_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "textbuffer.h"
+
+using namespace std;
+
+/// Receives the inferred perturbation scores of each sample and writes
+/// them in one output format
+class PerturbationWriter
+{
+private:
+  unique_ptr< ostream > _index;
+  TextBuffer _indexText;
+
+protected:
+  /// Formats that support an index report each sample's block, \a length
+  /// bytes at \a offset of the output, as it is written
+  void indexed(const string& sample, unsigned long long offset,
+	       size_t length);
+  /// Writers call this from flush() and finish()
+  void flushIndex() {
+    if (_index) {
+      _index->flush();
+    }
+  }
+
+public:
+  static const std::string INDEX_EXTENSION; // = ".idx"
+
+  PerturbationWriter() : _index(), _indexText(256) {}
+  virtual ~PerturbationWriter() {}
+
+  /// Also writes a "sample<TAB>offset<TAB>length" line to \a index for
+  /// each sample, in the order written
+  void indexTo(unique_ptr< ostream > index) { _index = std::move(index); }
+
+  /// Called once before the first sample with the output node names, in
+  /// the order of the scores passed to write()
+  virtual void begin(const vector< string >& nodes) = 0;
+
+  /// One sample; a score is NaN where it is NA
+  virtual void write(const string& sample, double loglikelihood,
+		     const vector< double >& scores) = 0;
+
+  /// Makes the samples written so far visible, where the format allows
+  virtual void flush() { flushIndex(); }
+
+  /// Called after the last sample
+  virtual void finish() = 0;
+};
+
+/// The text format read by the helper scripts: a "> sample
+/// loglikelihood=..." line, then a "node<TAB>score" line per node
+class FastaPerturbationWriter : public PerturbationWriter
+{
+protected:
+  unique_ptr< ostream > _file;
+  ostream& _out;
+  vector< string > _nodes;
+  TextBuffer _text;
+  unsigned long long _offset;
+
+  /// Writes out _text, keeping count of the bytes written
+  void writeBlock();
+
+public:
+  /// Writes to \a out
+  FastaPerturbationWriter(ostream& out);
+  /// Writes to a file opened with openOutput(), so possibly compressed
+  FastaPerturbationWriter(unique_ptr< ostream > file);
+
+  void begin(const vector< string >& nodes);
+  void write(const string& sample, double loglikelihood,
+	     const vector< double >& scores);
+  void flush();
+  void finish();
+};
+
+/// The fasta format without the nodes that carry no signal.  Only
+/// scores whose absolute value exceeds a threshold are written, and with
+/// a top_k only the k largest of those, in node order; NA scores are
+/// left out.  A "# format=sparse threshold=... [top_k=...]" line ahead of
+/// the first sample says which selection was used, so a node missing
+/// from a sample scored within the threshold rather than NA.
+class SparsePerturbationWriter : public FastaPerturbationWriter
+{
+public:
+  static const size_t ALL = size_t(-1);
+
+private:
+  double _threshold;
+  size_t _topK;
+  vector< size_t > _selected;
+
+public:
+  SparsePerturbationWriter(ostream& out, double threshold, size_t top_k);
+  SparsePerturbationWriter(unique_ptr< ostream > file, double threshold,
+			   size_t top_k);
+
+  void begin(const vector< string >& nodes);
+  void write(const string& sample, double loglikelihood,
+	     const vector< double >& scores);
+};
+
+/// Writes nothing, for runs that only want a summary
+class NullPerturbationWriter : public PerturbationWriter
+{
+public:
+  void begin(const vector< string >&) {}
+  void write(const string&, double, const vector< double >&) {}
+  void finish() {}
+};
+
+/// A line of pathway-level statistics per sample: its loglikelihood,
+/// the mean absolute score over the nodes that are not NA (NA if none
+/// are), the number of nodes whose absolute score exceeds a threshold
+/// and the number of NA nodes.  A "# threshold=..." line and a column
+/// header come first.
+class SummaryPerturbationWriter : public PerturbationWriter
+{
+private:
+  unique_ptr< ostream > _file;
+  double _threshold;
+  TextBuffer _text;
+
+public:
+  SummaryPerturbationWriter(unique_ptr< ostream > file, double threshold);
+
+  void begin(const vector< string >& nodes);
+  void write(const string& sample, double loglikelihood,
+	     const vector< double >& scores);
+  void flush();
+  void finish();
+};
+
+/// Passes every call on to each of several writers, in order
+class TeePerturbationWriter : public PerturbationWriter
+{
+private:
+  vector< unique_ptr< PerturbationWriter > > _writers;
+
+public:
+  TeePerturbationWriter(vector< unique_ptr< PerturbationWriter > > writers);
+
+  void begin(const vector< string >& nodes);
+  void write(const string& sample, double loglikelihood,
+	     const vector< double >& scores);
+  void flush();
+  void finish();
+};
+
+#endif
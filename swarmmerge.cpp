@@ -0,0 +1,331 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.h"
+#include "compressedio.h"
+#include "perturbationmatrix.h"
+#include "swarmmerge.h"
+#include "textbuffer.h"
+
+#define THROW(msg) throw std::runtime_error(msg)
+
+namespace {
+
+bool isSwarmFile(const string& path)
+{
+  return endsWith(path, ".fa") || endsWith(path, ".fa.gz")
+    || endsWith(path, ".fa.zst") || endsWith(path, PerturbationMatrix::EXTENSION);
+}
+
+/// Python's str.strip(chars) on both ends of \a s
+string_view strip(string_view s, const char* chars)
+{
+  size_t b = s.find_first_not_of(chars);
+  if (b == string_view::npos) {
+    return string_view();
+  }
+  size_t e = s.find_last_not_of(chars);
+  return s.substr(b, e - b + 1);
+}
+
+/// The values of one pathway, indexed by node and sample.  The files
+/// are read as streams and only the names and values are kept, in an
+/// arena of blocks that never move, so the views into it stay valid.
+class MergedGroup
+{
+private:
+  static const size_t NONE = size_t(-1);
+  static const size_t ARENA_BLOCK = 1 << 20;
+
+  vector< string_view > _nodes;
+  unordered_map< string_view, size_t > _nodeIndex;
+  vector< string_view > _samples;
+  unordered_map< string_view, size_t > _sampleIndex;
+  // a view with NULL data marks a missing value, as "" is a value
+  vector< vector< string_view > > _values;
+  deque< string > _arena;
+
+  /// A copy of \a s in the arena
+  string_view keep(string_view s) {
+    if (_arena.empty()
+	|| _arena.back().capacity() - _arena.back().size() < s.size()) {
+      _arena.push_back(string());
+      _arena.back().reserve(max(size_t(ARENA_BLOCK), s.size()));
+    }
+    string& block = _arena.back();
+    size_t at = block.size();
+    block.append(s.data(), s.size());
+    return string_view(block.data() + at, s.size());
+  }
+
+  size_t intern(string_view s, vector< string_view >& names,
+		unordered_map< string_view, size_t >& index) {
+    unordered_map< string_view, size_t >::const_iterator i = index.find(s);
+    if (i != index.end()) {
+      return i->second;
+    }
+    names.push_back(keep(s));
+    index.emplace(names.back(), names.size() - 1);
+    return names.size() - 1;
+  }
+
+  void set(string_view node, size_t sample, string_view value) {
+    size_t n = intern(node, _nodes, _nodeIndex);
+    if (n == _values.size()) {
+      _values.push_back(vector< string_view >());
+    }
+    if (_values[n].size() <= sample) {
+      _values[n].resize(sample + 1);
+    }
+    _values[n][sample] = keep(value);
+  }
+
+  void addFasta(const string& filename, const string& prefix);
+  void addMatrix(const string& filename, const string& prefix);
+
+  vector< size_t > sortedNodes() const;
+  vector< size_t > sortedSamples() const;
+  string_view value(size_t node, size_t sample) const {
+    return sample < _values[node].size() ? _values[node][sample]
+      : string_view();
+  }
+
+public:
+  void add(const string& filename);
+  void write(const string& filename) const;
+  void writeTranspose(const string& filename) const;
+};
+
+void MergedGroup::add(const string& filename)
+{
+  string prefix;
+  if (filename.find("nw_") != string::npos) {
+    prefix = "nw_";
+  } else if (filename.find("na_") != string::npos) {
+    prefix = "na_";
+  }
+  if (endsWith(filename, PerturbationMatrix::EXTENSION)) {
+    addMatrix(filename, prefix);
+  } else {
+    addFasta(filename, prefix);
+  }
+}
+
+void MergedGroup::addFasta(const string& filename, const string& prefix)
+{
+  unique_ptr< istream > in = openInput(filename);
+  if (!*in) {
+    THROW("Couldn't open " + filename);
+  }
+
+  // a sample is only added once it has a value
+  string text;
+  string header;
+  bool inSample = false;
+  size_t sample = NONE;
+  while (getline(*in, text)) {
+    string_view line(text);
+    if (!line.empty() && line[0] == '>') {
+      header = prefix;
+      header += strip(strip(line, ">"), " \t\r\v\f");
+      inSample = true;
+      sample = NONE;
+      continue;
+    }
+    size_t tab = line.find('\t');
+    if (!inSample || tab == string_view::npos) {
+      continue;
+    }
+    if (sample == NONE) {
+      sample = intern(header, _samples, _sampleIndex);
+    }
+    string_view value = line.substr(tab + 1);
+    value = value.substr(0, value.find('\t'));
+    set(line.substr(0, tab), sample, value);
+  }
+  if (in->bad()) {
+    THROW("Couldn't read " + filename);
+  }
+}
+
+void MergedGroup::addMatrix(const string& filename, const string& prefix)
+{
+  PerturbationMatrix m(filename, MappedFile::SEQUENTIAL);
+  // the text the fasta writer would have written, a row at a time
+  TextBuffer text;
+  for (size_t r = 0; r < m.samples(); ++r) {
+    text << prefix << m.sample(r) << " loglikelihood=" << m.loglikelihood(r);
+    size_t sample = intern(text.view(), _samples, _sampleIndex);
+    text.clear();
+    for (size_t c = 0; c < m.nodes(); ++c) {
+      if (std::isnan(m.score(r, c))) {
+	text << "NA";
+      } else {
+	text << (double)m.score(r, c);
+      }
+      set(m.node(c), sample, text.view());
+      text.clear();
+    }
+  }
+}
+
+vector< size_t > MergedGroup::sortedNodes() const
+{
+  vector< size_t > order(_nodes.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return _nodes[a] < _nodes[b];
+    });
+  return order;
+}
+
+vector< size_t > MergedGroup::sortedSamples() const
+{
+  vector< size_t > order(_samples.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  // reversed, which puts "sample" names on top
+  sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return _samples[a] > _samples[b];
+    });
+  return order;
+}
+
+ofstream& openMerged(ofstream& out, const string& filename)
+{
+  out.open(filename.c_str());
+  if (!out) {
+    THROW("Couldn't open " + filename);
+  }
+  return out;
+}
+
+void MergedGroup::write(const string& filename) const
+{
+  vector< size_t > nodes = sortedNodes();
+  vector< size_t > samples = sortedSamples();
+  ofstream out;
+  openMerged(out, filename);
+  TextBuffer text;
+  text << "id";
+  for (size_t n = 0; n < nodes.size(); ++n) {
+    text << '\t' << _nodes[nodes[n]];
+  }
+  text << '\n';
+  for (size_t s = 0; s < samples.size(); ++s) {
+    text << _samples[samples[s]];
+    for (size_t n = 0; n < nodes.size(); ++n) {
+      string_view v = value(nodes[n], samples[s]);
+      text << '\t' << (v.data() == NULL ? string_view("NA") : v);
+    }
+    text << '\n';
+    text.writeTo(out);
+  }
+  text.writeTo(out);
+  if (!out.flush()) {
+    THROW("Couldn't write " + filename);
+  }
+}
+
+void MergedGroup::writeTranspose(const string& filename) const
+{
+  vector< size_t > nodes = sortedNodes();
+  vector< size_t > samples = sortedSamples();
+  ofstream out;
+  openMerged(out, filename);
+  TextBuffer text;
+  text << "id";
+  for (size_t s = 0; s < samples.size(); ++s) {
+    text << '\t' << _samples[samples[s]];
+  }
+  text << '\n';
+  for (size_t n = 0; n < nodes.size(); ++n) {
+    text << _nodes[nodes[n]];
+    for (size_t s = 0; s < samples.size(); ++s) {
+      string_view v = value(nodes[n], samples[s]);
+      text << '\t' << (v.data() == NULL ? string_view("NA") : v);
+    }
+    text << '\n';
+    text.writeTo(out);
+  }
+  text.writeTo(out);
+  if (!out.flush()) {
+    THROW("Couldn't write " + filename);
+  }
+}
+
+}
+
+vector< string > findSwarmFiles(const string& directory)
+{
+  vector< string > files;
+  std::error_code ec;
+  std::filesystem::recursive_directory_iterator i(directory, ec), end;
+  if (ec) {
+    THROW("Couldn't read directory " + directory + ": " + ec.message());
+  }
+  for (; i != end; i.increment(ec)) {
+    if (ec) {
+      THROW("Couldn't read directory " + directory + ": " + ec.message());
+    }
+    string path = i->path().string();
+    if (i->is_regular_file() && isSwarmFile(path)) {
+      files.push_back(path);
+    }
+  }
+  sort(files.begin(), files.end());
+  return files;
+}
+
+map< string, vector< string > > groupSwarmFiles(const vector< string >& files)
+{
+  map< string, vector< string > > groups;
+  for (size_t i = 0; i < files.size(); ++i) {
+    size_t p = files[i].find("pid");
+    if (p == string::npos) {
+      continue;
+    }
+    size_t first = files[i].find('_', p);
+    if (first == string::npos) {
+      continue;
+    }
+    size_t second = files[i].find('_', first + 1);
+    groups[files[i].substr(p, second == string::npos ? string::npos
+			   : second - p)].push_back(files[i]);
+  }
+  return groups;
+}
+
+void mergeSwarmGroup(const string& pid, const vector< string >& files,
+		     const string& outdir)
+{
+  MergedGroup group;
+  for (size_t i = 0; i < files.size(); ++i) {
+    try {
+      group.add(files[i]);
+    } catch (const std::exception& e) {
+      THROW(files[i] + ": " + e.what());
+    }
+  }
+  std::filesystem::path dir(outdir);
+  group.write((dir / ("merged_" + pid + ".out")).string());
+  group.writeTranspose((dir / ("merged_transpose_" + pid + ".out")).string());
+}
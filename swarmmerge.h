@@ -0,0 +1,40 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_SWARMMERGE_H
+#define HEADER_SWARMMERGE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// The perturbation outputs of a swarm run found under \a directory:
+/// fasta files ending in .fa (optionally .gz or .zst compressed) and
+/// binary PerturbationMatrix files, sorted by path
+vector< string > findSwarmFiles(const string& directory);
+
+/// Groups \a files by the pathway id in their path, "pid_<n>" taken from
+/// the first "pid" on, as helperScripts/mergeSwarmFiles.py does.  Files
+/// without one are left out.
+map< string, vector< string > > groupSwarmFiles(const vector< string >& files);
+
+/// Merges the outputs of one pathway into \a outdir/merged_<pid>.out, a
+/// samples by nodes matrix, and merged_transpose_<pid>.out, its
+/// transpose.  The text matches mergeSwarmFiles.py: nodes are sorted,
+/// samples reverse sorted and named by their whole "> ..." line, "nw_"
+/// or "na_" is prefixed to the samples of files with that in their
+/// path, missing values are NA and a later file overrides an earlier
+/// one.  Binary files give the text the fasta writer would have, but
+/// from float scores, so the last digit can differ.  The files are read
+/// as streams, so only this group's names and values are held in memory.
+void mergeSwarmGroup(const string& pid, const vector< string >& files,
+		     const string& outdir);
+
+#endif
@@ -0,0 +1,83 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_SYMBOLTABLE_H
+#define HEADER_SYMBOLTABLE_H
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/// Interns strings as dense integer ids, so that graph structures can be
+/// keyed and compared by small integers instead of by name.
+class SymbolTable
+{
+public:
+  typedef unsigned int Symbol;
+  static constexpr Symbol NONE = ~0u;
+
+private:
+  // deque never relocates its elements, so the views in _ids stay valid
+  std::deque< std::string > _names;
+  std::unordered_map< std::string_view, Symbol > _ids;
+
+  void rebuildIndex() {
+    _ids.clear();
+    for (size_t i = 0; i < _names.size(); ++i) {
+      _ids[_names[i]] = i;
+    }
+  }
+
+public:
+  /// Default constructor
+  SymbolTable() : _names(), _ids() {}
+
+  /// Copy constructor
+  SymbolTable(const SymbolTable &x) : _names(x._names), _ids() {
+    rebuildIndex();
+  }
+
+  /// Assignment operator
+  SymbolTable& operator=(const SymbolTable &x) {
+    if (this != &x) {
+      _names = x._names;
+      rebuildIndex();
+    }
+    return *this;
+  }
+
+  /// Moving a deque keeps its elements in place, so the index moves as-is
+  SymbolTable(SymbolTable &&x) = default;
+  SymbolTable& operator=(SymbolTable &&x) = default;
+
+  /// Returns the id of \a s, adding it to the table if it is new
+  Symbol intern(std::string_view s) {
+    std::unordered_map< std::string_view, Symbol >::const_iterator i;
+    i = _ids.find(s);
+    if (i != _ids.end()) {
+      return i->second;
+    }
+    Symbol id = _names.size();
+    _names.push_back(std::string(s));
+    _ids[_names.back()] = id;
+    return id;
+  }
+
+  /// Returns the id of \a s, or NONE if it has never been interned
+  Symbol find(std::string_view s) const {
+    std::unordered_map< std::string_view, Symbol >::const_iterator i;
+    i = _ids.find(s);
+    return i == _ids.end() ? NONE : i->second;
+  }
+
+  const std::string& name(Symbol id) const { return _names[id]; }
+  size_t size() const { return _names.size(); }
+};
+
+#endif
@@ -0,0 +1,54 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_TABTOKENIZER_H
+#define HEADER_TABTOKENIZER_H
+
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+/// Splits the lines of a buffer into tab separated fields without
+/// copying them.  Fields follow dai::tokenizeString: empty fields are
+/// kept, a trailing tab does not start another field, and an empty line
+/// has no fields.
+class TabTokenizer
+{
+private:
+  const char* _p;
+  const char* _end;
+
+public:
+  TabTokenizer(const char* begin, const char* end) : _p(begin), _end(end) {}
+
+  /// Replaces \a fields with those of the next line; false at the end.
+  /// The views point into the buffer and stay valid as long as it does.
+  bool next(std::vector< std::string_view >& fields) {
+    if (_p == _end) {
+      return false;
+    }
+    const char* eol = static_cast< const char* >(memchr(_p, '\n', _end - _p));
+    if (eol == NULL) {
+      eol = _end;
+    }
+    fields.clear();
+    while (_p < eol) {
+      const char* tab = static_cast< const char* >(memchr(_p, '\t', eol - _p));
+      if (tab == NULL) {
+	tab = eol;
+      }
+      fields.push_back(std::string_view(_p, tab - _p));
+      _p = tab + 1;
+    }
+    _p = eol == _end ? _end : eol + 1;
+    return true;
+  }
+};
+
+#endif
@@ -25,3 +25,236 @@ echo Testing EM, should take approximately five minutes
     | python ../helperScripts/diffSwarmFiles.py em_simple.cfg.out -\
     | diff - /dev/null \
     || exit 1
+
+echo Testing inference on multiple threads, should take less than a minute
+../paradigm -t 4 -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+
+echo Testing chain compression, should take approximately five minutes
+cp noem.cfg noem_chains.cfg
+echo 'pathway [compress_chains=true]' >> noem_chains.cfg
+../paradigm -c noem_chains.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+cp em_simple.cfg em_chains.cfg
+echo 'pathway [compress_chains=true]' >> em_chains.cfg
+../paradigm -c em_chains.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    | python ../helperScripts/diffSwarmFiles.py em_simple.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -f noem_chains.cfg em_chains.cfg
+
+echo Testing the compiled pathway cache, should take less than a minute
+rm -f small_pid_66_pathway.tab.pwb
+../paradigm -w -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    > /dev/null || exit 1
+test -f small_pid_66_pathway.tab.pwb || exit 1
+../paradigm -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -f small_pid_66_pathway.tab.pwb
+
+echo Testing batch pathway compilation, should take seconds
+rm -f complex_family_pathway.tab.pwb needs_split_1.pathway.tab.pwb
+../pathwaytab2daifg -w -t 2 complex_family_pathway.tab needs_split_1.pathway.tab \
+    || exit 1
+test -f complex_family_pathway.tab.pwb -a -f needs_split_1.pathway.tab.pwb \
+    || exit 1
+rm -f complex_family_pathway.tab.pwb needs_split_1.pathway.tab.pwb
+(echo '# complex_family_pathway.tab'
+ ../pathwaytab2daifg complex_family_pathway.tab
+ echo '# needs_split_1.pathway.tab'
+ ../pathwaytab2daifg needs_split_1.pathway.tab) > graphs_expected.fg \
+    || exit 1
+../pathwaytab2daifg -b -t 2 complex_family_pathway.tab needs_split_1.pathway.tab \
+    | diff - graphs_expected.fg \
+    || exit 1
+rm -f graphs_expected.fg
+
+echo Testing binary evidence matrices, should take less than a minute
+../evidencetab2bin small_pid_66_genome.tab || exit 1
+../evidencetab2bin -d '-1.3;1.3' small_pid_66_mRNA.tab || exit 1
+../paradigm -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+printf '\001' | dd of=small_pid_66_genome.tab.evb bs=1 seek=69 conv=notrunc \
+    2> /dev/null || exit 1
+touch small_pid_66_genome.tab.evb
+../paradigm -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    2> damaged_evb.err \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+grep -q 'Not a valid evidence matrix' damaged_evb.err || exit 1
+rm -f small_pid_66_genome.tab.evb small_pid_66_mRNA.tab.evb damaged_evb.err
+
+echo Testing streaming inference, should take less than a minute
+../paradigm -s -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+
+echo Testing compressed evidence and output, should take less than a minute
+gzip -c small_pid_66_genome.tab > small_pid_66_genome.tab.gz || exit 1
+gzip -c small_pid_66_mRNA.tab > small_pid_66_mRNA.tab.gz || exit 1
+sed 's/\.tab/.tab.gz/g' noem.cfg > noem_gz.cfg
+../paradigm -c noem_gz.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    -o noem_gz.out.gz || exit 1
+gzip -dc noem_gz.out.gz \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -f small_pid_66_genome.tab.gz small_pid_66_mRNA.tab.gz noem_gz.cfg \
+    noem_gz.out.gz
+
+echo Testing binary perturbation output, should take less than a minute
+cp noem.cfg noem_bin.cfg
+echo 'output [format=binary]' >> noem_bin.cfg
+rm -rf merge_in merge_out
+mkdir -p merge_in merge_out
+../paradigm -c noem_bin.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    -o merge_in/pid_66_noem.ptb -i || exit 1
+../lookupsample merge_in/pid_66_noem.ptb sample_2 \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -f merge_in/pid_66_noem.ptb.idx
+../mergeswarmfiles merge_in merge_out > /dev/null || exit 1
+awk -F'\t' 'NR == 1 { print ">" $2; next } { print }' \
+    merge_out/merged_transpose_pid_66.out \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -rf noem_bin.cfg merge_in merge_out
+
+echo Testing sparse perturbation output, should take less than a minute
+cp noem.cfg noem_sparse.cfg
+echo 'output [format=sparse,threshold=1e9]' >> noem_sparse.cfg
+../paradigm -c noem_sparse.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    > noem_sparse.out || exit 1
+head -1 noem_sparse.out | grep -q '^# format=sparse threshold=1e+09$' || exit 1
+test `grep -vc '^[#>]' noem_sparse.out` -eq 0 || exit 1
+cp noem.cfg noem_sparse.cfg
+echo 'output [format=sparse,threshold=0]' >> noem_sparse.cfg
+../paradigm -c noem_sparse.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    > noem_sparse.out || exit 1
+awk -F'\t' '/^>/ || $2 + 0 != 0' noem.cfg.out > noem_nonzero.out
+grep -v '^#' noem_sparse.out \
+    | python ../helperScripts/diffSwarmFiles.py noem_nonzero.out -\
+    | diff - /dev/null \
+    || exit 1
+test `grep -vc '^#' noem_sparse.out` -eq `wc -l < noem_nonzero.out` || exit 1
+cp noem.cfg noem_sparse.cfg
+echo 'output [format=sparse,threshold=0,top_k=1]' >> noem_sparse.cfg
+../paradigm -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66_multi \
+    > multi_full.out || exit 1
+../paradigm -c noem_sparse.cfg -p small_pid_66_pathway.tab -b small_pid_66_multi \
+    > noem_sparse.out || exit 1
+# the largest |score| of each sample, ties to the earlier node
+awk -F'\t' 'function flush() { if (best != "") print best; best = ""; top = 0 }
+    /^>/ { flush(); print; next }
+    { a = $2 < 0 ? -$2 : $2; if (a > top) { top = a; best = $0 } }
+    END { flush() }' multi_full.out | diff - <(grep -v '^#' noem_sparse.out) \
+    || exit 1
+rm -f noem_sparse.cfg noem_sparse.out noem_nonzero.out multi_full.out
+
+echo Testing merging of outputs, should take less than a minute
+rm -rf merge_in merge_out merge_py
+mkdir -p merge_in merge_out merge_py
+cp noem.cfg.out merge_in/pid_66_noem.fa
+cp noem.cfg.out merge_in/na_pid_66_noem.fa
+cp em_simple.cfg.out merge_in/nw_pid_66_em.fa
+../paradigm -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66_multi \
+    -o merge_in/pid_66_multi.fa || exit 1
+python ../helperScripts/mergeSwarmFiles.py merge_in merge_py > /dev/null \
+    || exit 1
+../mergeswarmfiles -t 2 merge_in merge_out > /dev/null || exit 1
+diff merge_py/merged_pid_66.out merge_out/merged_pid_66.out || exit 1
+diff merge_py/merged_transpose_pid_66.out \
+    merge_out/merged_transpose_pid_66.out || exit 1
+gzip merge_in/pid_66_multi.fa || exit 1
+rm -f merge_out/*
+../mergeswarmfiles merge_in merge_out > /dev/null || exit 1
+diff merge_py/merged_pid_66.out merge_out/merged_pid_66.out || exit 1
+rm -rf merge_in merge_out merge_py
+
+echo Testing summary only output, should take less than a minute
+cp noem.cfg noem_summary.cfg
+echo 'output [format=none,threshold=0.5]' >> noem_summary.cfg
+../paradigm -c noem_summary.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    -a noem_summary.tsv | diff - /dev/null || exit 1
+test `wc -l < noem_summary.tsv` -eq 3 || exit 1
+awk -F'\t' '/^>/ { split($0, h, "="); ll = h[2]; next }
+     $2 == "NA" { ++na; next }
+     { a = $2 < 0 ? -$2 : $2; total += a; n++; above += a > 0.5 }
+     END { print ll "\t" total / n "\t" above + 0 "\t" na + 0 }' \
+    noem.cfg.out > noem_summary_expected.tsv
+tail -n 1 noem_summary.tsv | cut -f 2- | paste - noem_summary_expected.tsv \
+    | awk -F'\t' 'function off(x, y) { d = x - y; if (d < 0) d = -d;
+                                    return d > 1e-4 * (1 + (y < 0 ? -y : y)) }
+                  NF != 8 || off($1, $5) || off($2, $6) || $3 != $7 || $4 != $8' \
+    | diff - /dev/null || exit 1
+rm -f noem_summary.cfg noem_summary.tsv noem_summary_expected.tsv
+
+echo Testing the sample index, should take less than a minute
+../paradigm -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66_multi \
+    -o multi_index.fa -i || exit 1
+test `wc -l < multi_index.fa.idx` -eq 4 || exit 1
+awk '/^>/ { keep = ($2 == "sample_3") } keep' multi_index.fa \
+    > multi_sample_3.fa
+test -s multi_sample_3.fa || exit 1
+../lookupsample multi_index.fa sample_3 | diff - multi_sample_3.fa || exit 1
+cp noem.cfg multi_index.cfg
+echo 'output [format=sparse,threshold=0]' >> multi_index.cfg
+../paradigm -c multi_index.cfg -p small_pid_66_pathway.tab -b small_pid_66_multi \
+    -o multi_index.sparse -i || exit 1
+awk '/^>/ { keep = ($2 == "sample_3") } keep' multi_index.sparse \
+    | diff - <(../lookupsample multi_index.sparse sample_3) || exit 1
+cp noem.cfg multi_index.cfg
+echo 'output [format=binary]' >> multi_index.cfg
+../paradigm -c multi_index.cfg -p small_pid_66_pathway.tab -b small_pid_66_multi \
+    -o multi_index.ptb -i || exit 1
+../lookupsample multi_index.ptb sample_3 \
+    | python ../helperScripts/diffSwarmFiles.py multi_sample_3.fa -\
+    | diff - /dev/null \
+    || exit 1
+rm -f multi_index.cfg multi_sample_3.fa multi_index.fa multi_index.fa.idx \
+    multi_index.sparse multi_index.sparse.idx multi_index.ptb multi_index.ptb.idx
+
+echo Testing binary EM parameters, should take less than a minute
+../paradigm -c em_simple.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    -e em_simple.emb > /dev/null || exit 1
+test -s em_simple.emb || exit 1
+../paradigm -c noem.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    -l em_simple.emb \
+    | python ../helperScripts/diffSwarmFiles.py em_simple.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -f em_simple.emb
+sed 's/^em_step .*/em_step [_mRNA.tab=-obs>,nosuch=-t>]/' em_simple.cfg \
+    > em_unmatched.cfg
+sed 's/^em_step .*/em_step [_mRNA.tab=-obs>,nosuch=-t>]/' noem.cfg \
+    > noem_unmatched.cfg
+../paradigm -c em_unmatched.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    -e em_unmatched.emb > em_unmatched.out || exit 1
+test -s em_unmatched.emb || exit 1
+../paradigm -c noem_unmatched.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    -l em_unmatched.emb \
+    | python ../helperScripts/diffSwarmFiles.py em_unmatched.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -f em_unmatched.cfg noem_unmatched.cfg em_unmatched.emb em_unmatched.out
+
+echo Testing evidence from a pipe, should take less than a minute
+sed 's/suffix=_genome.tab,/suffix=_genome.tab,input=-,/' noem.cfg > noem_stdin.cfg
+cat small_pid_66_genome.tab \
+    | ../paradigm -s -c noem_stdin.cfg -p small_pid_66_pathway.tab -b small_pid_66 \
+    | python ../helperScripts/diffSwarmFiles.py noem.cfg.out -\
+    | diff - /dev/null \
+    || exit 1
+rm -f noem_stdin.cfg
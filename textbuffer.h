@@ -0,0 +1,87 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+
+#ifndef HEADER_TEXTBUFFER_H
+#define HEADER_TEXTBUFFER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Builds text output in a reusable buffer and hands it to an ostream in
+/// one write.  Numbers are formatted with std::to_chars, which skips the
+/// locale and stream state that operator<< consults for every value.
+/// Doubles default to the general format with 6 significant digits, the
+/// same text as an unmodified ostream; a precision of 0 gives the
+/// shortest text that reads back as the same double.
+class TextBuffer
+{
+private:
+  std::vector< char > _buf;
+  size_t _size;
+  int _precision;
+
+  char* reserve(size_t n) {
+    if (_size + n > _buf.size()) {
+      _buf.resize(std::max(_buf.size() * 2, _size + n));
+    }
+    return _buf.data() + _size;
+  }
+
+public:
+  explicit TextBuffer(size_t capacity = 1 << 16, int precision = 6)
+    : _buf(capacity), _size(0), _precision(precision) {}
+
+  TextBuffer& operator<<(char c) {
+    *reserve(1) = c;
+    ++_size;
+    return *this;
+  }
+  TextBuffer& operator<<(std::string_view s) {
+    memcpy(reserve(s.size()), s.data(), s.size());
+    _size += s.size();
+    return *this;
+  }
+  TextBuffer& operator<<(const char* s) { return *this << std::string_view(s); }
+  TextBuffer& operator<<(const std::string& s) {
+    return *this << std::string_view(s);
+  }
+  TextBuffer& operator<<(size_t n) {
+    char* p = reserve(20);
+    _size = std::to_chars(p, p + 20, n).ptr - _buf.data();
+    return *this;
+  }
+  TextBuffer& operator<<(double x) {
+    // enough for a sign, 17 digits, a point and a four digit exponent
+    char* p = reserve(32);
+    std::to_chars_result r = _precision > 0
+      ? std::to_chars(p, p + 32, x, std::chars_format::general, _precision)
+      : std::to_chars(p, p + 32, x);
+    _size = r.ptr - _buf.data();
+    return *this;
+  }
+
+  size_t size() const { return _size; }
+  /// The buffered text, valid until the next append
+  std::string_view view() const { return std::string_view(_buf.data(), _size); }
+  void clear() { _size = 0; }
+
+  /// Writes the buffered text to \a out and empties the buffer, keeping
+  /// its storage for the next use
+  void writeTo(std::ostream& out) {
+    out.write(_buf.data(), _size);
+    _size = 0;
+  }
+};
+
+#endif
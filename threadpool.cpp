@@ -0,0 +1,116 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#include "threadpool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t threads)
+  : _workers(),
+    _lock(),
+    _wake(),
+    _done(),
+    _task(NULL),
+    _next(0),
+    _count(0),
+    _finished(0),
+    _generation(0),
+    _stop(false),
+    _error()
+{
+  for (size_t i = 1; i < threads; ++i) {
+    _workers.push_back(thread(&ThreadPool::workerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    lock_guard< mutex > l(_lock);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    _workers[i].join();
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  size_t seen = 0;
+  unique_lock< mutex > l(_lock);
+  while (true) {
+    _wake.wait(l, [&] { return _stop || _generation != seen; });
+    if (_stop) {
+      return;
+    }
+    seen = _generation;
+    l.unlock();
+    runTasks();
+    l.lock();
+  }
+}
+
+void ThreadPool::runTasks()
+{
+  while (true) {
+    const function< void(size_t) >* task;
+    size_t i;
+    {
+      lock_guard< mutex > l(_lock);
+      if (_task == NULL || _next >= _count) {
+	return;
+      }
+      task = _task;
+      i = _next++;
+    }
+    try {
+      (*task)(i);
+    } catch (...) {
+      lock_guard< mutex > l(_lock);
+      if (!_error) {
+	_error = current_exception();
+      }
+    }
+    lock_guard< mutex > l(_lock);
+    if (++_finished == _count) {
+      _done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::parallelFor(size_t count, const function< void(size_t) >& task)
+{
+  if (_workers.empty() || count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  unique_lock< mutex > l(_lock);
+  _task = &task;
+  _next = 0;
+  _count = count;
+  _finished = 0;
+  _error = exception_ptr();
+  ++_generation;
+  l.unlock();
+  _wake.notify_all();
+
+  runTasks();
+
+  l.lock();
+  _done.wait(l, [&] { return _finished == _count; });
+  _task = NULL;
+  exception_ptr error = _error;
+  l.unlock();
+  if (error) {
+    rethrow_exception(error);
+  }
+}
@@ -0,0 +1,55 @@
+/********************************************************************************/
+/* Copyright 2009-2011 -- The Regents of the University of California           */
+/* This code is provided for research purposes to scientists at non-profit		*/
+/*  organizations.  All other use is strictly prohibited.  For further			*/
+/*  details please contact University of California, Santa Cruz or				*/
+/*	Five3 Genomics, LLC (http://five3genomics.com).								*/
+/********************************************************************************/
+
+#ifndef HEADER_THREADPOOL_H
+#define HEADER_THREADPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A fixed set of worker threads for data-parallel loops.  The thread
+/// calling parallelFor() works alongside the pool, so a pool of size one
+/// has no workers and simply runs the loop inline.
+class ThreadPool
+{
+private:
+  std::vector< std::thread > _workers;
+  std::mutex _lock;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const std::function< void(size_t) >* _task;
+  size_t _next;
+  size_t _count;
+  size_t _finished;
+  size_t _generation;
+  bool _stop;
+  std::exception_ptr _error;
+
+  void workerLoop();
+  void runTasks();
+
+public:
+  /// Starts \a threads - 1 workers
+  ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &x) = delete;
+  ThreadPool& operator=(const ThreadPool &x) = delete;
+
+  size_t size() const { return _workers.size() + 1; }
+
+  /// Calls task(i) for every i in [0, count) and waits for all of them
+  /// to finish; the first exception thrown by a task is rethrown here
+  void parallelFor(size_t count, const std::function< void(size_t) >& task);
+};
+
+#endif